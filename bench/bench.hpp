@@ -0,0 +1,55 @@
+#ifndef _BENCH_
+#define _BENCH_
+
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <vector>
+
+// small helpers shared by the benchmarks, everything is printed as "name value unit" lines so runs are easy to diff
+namespace bench {
+    // CLOCK_MONOTONIC is the same clock in every process, the mock player stamps its track changes with it
+    inline int64_t monotonicNs() {
+        timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+    }
+
+    // user + system time of the whole process
+    inline int64_t cpuTimeUs() {
+        rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        return static_cast<int64_t>(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000 + usage.ru_utime.tv_usec +
+               usage.ru_stime.tv_usec;
+    }
+
+    inline void report(const char* name, double value, const char* unit) {
+        printf("%-40s %12.3f %s\n", name, value, unit);
+    }
+
+    // p50/p90/p99/max of samples in nanoseconds, printed in milliseconds
+    inline void reportLatencies(const char* name, std::vector<int64_t> samples) {
+        char label[64];
+        snprintf(label, sizeof(label), "%s.samples", name);
+        report(label, static_cast<double>(samples.size()), "");
+        if (samples.empty())
+            return;
+
+        std::sort(samples.begin(), samples.end());
+        auto percentile = [&samples](double p) {
+            size_t index = static_cast<size_t>(p * (samples.size() - 1) + 0.5);
+            return samples[index] / 1e6;
+        };
+        for (auto [suffix, p] : {std::make_pair("p50", 0.5), std::make_pair("p90", 0.9), std::make_pair("p99", 0.99)}) {
+            snprintf(label, sizeof(label), "%s.%s", name, suffix);
+            report(label, percentile(p), "ms");
+        }
+        snprintf(label, sizeof(label), "%s.max", name);
+        report(label, samples.back() / 1e6, "ms");
+    }
+}  // namespace bench
+
+#endif
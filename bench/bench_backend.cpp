@@ -0,0 +1,88 @@
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <thread>
+
+#include "../src/backend.hpp"
+#include "bench.hpp"
+
+// measures the linux backend on its own: how long a poll takes, how much it allocates, and how much cpu watching the
+// players costs over time. Expects mock_player (or real players) on the session bus.
+
+namespace {
+    std::atomic<uint64_t> allocations{0};
+}
+
+void* operator new(size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+
+int main(int argc, char** argv) {
+    int polls = 2000;
+    int watchSeconds = 20;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--polls") == 0 && i + 1 < argc)
+            polls = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--watch-seconds") == 0 && i + 1 < argc)
+            watchSeconds = atoi(argv[++i]);
+        else {
+            fprintf(stderr, "usage: %s [--polls n] [--watch-seconds s]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    if (!backend::init()) {
+        fprintf(stderr, "bench_backend: backend::init() failed, is DBUS_SESSION_BUS_ADDRESS set?\n");
+        return 1;
+    }
+
+    // give the backend a moment to discover the players before measuring anything
+    MediaInfo media;
+    auto warmupEnd = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+    while (std::chrono::steady_clock::now() < warmupEnd) {
+        backend::waitForMediaChange(std::chrono::milliseconds(100));
+        backend::getMediaInformation(media);
+    }
+
+    // back to back polls, the way the pipeline asks after every change
+    std::vector<int64_t> latencies;
+    latencies.reserve(polls);
+    uint64_t pollAllocations = 0;
+    int playing = 0;
+    for (int i = 0; i < polls; i++) {
+        uint64_t allocationsBefore = allocations.load(std::memory_order_relaxed);
+        int64_t start = bench::monotonicNs();
+        playing += backend::getMediaInformation(media);
+        int64_t end = bench::monotonicNs();
+        pollAllocations += allocations.load(std::memory_order_relaxed) - allocationsBefore;
+        latencies.push_back(end - start);
+    }
+    bench::reportLatencies("poll.latency", latencies);
+    bench::report("poll.allocations", polls ? static_cast<double>(pollAllocations) / polls : 0, "per poll");
+    bench::report("poll.playing", polls ? 100.0 * playing / polls : 0, "%");
+
+    // the watcher loop from the pipeline, cpu time extrapolated to an hour
+    int64_t cpuBefore = bench::cpuTimeUs();
+    auto watchEnd = std::chrono::steady_clock::now() + std::chrono::seconds(watchSeconds);
+    int changes = 0;
+    while (std::chrono::steady_clock::now() < watchEnd) {
+        if (!backend::waitForMediaChange(std::chrono::seconds(1)))
+            continue;
+        backend::getMediaInformation(media);
+        changes++;
+    }
+    double cpuSeconds = (bench::cpuTimeUs() - cpuBefore) / 1e6;
+    bench::report("watch.changes", changes, "");
+    bench::report("watch.cpu_per_hour", watchSeconds ? cpuSeconds * 3600 / watchSeconds : 0, "s");
+
+    // the backend's dbus thread is still running, skip the static destructors
+    std::fflush(stdout);
+    std::_Exit(0);
+}
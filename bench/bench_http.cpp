@@ -0,0 +1,86 @@
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "../src/http.hpp"
+#include "bench.hpp"
+#include "local_server.hpp"
+
+// per request latency of the http client against a local stand-in for itunes/last.fm, so the network doesn't drown
+// out what the client itself costs. "fresh" is how requests used to be made, a new easy handle and curl_global_init
+// for every request and so a new connection every time, "pooled" goes through HttpClient and keeps the connection.
+
+namespace {
+    const std::string responseBody =
+        R"({"resultCount":1,"results":[{"trackId":1440833098,"artworkUrl100":"https://example.com/cover.jpg"}]})";
+
+    size_t writeCallback(char* contents, size_t size, size_t nmemb, void* userp) {
+        ((std::string*)userp)->append(contents, size * nmemb);
+        return size * nmemb;
+    }
+
+    // the old utils::httpRequest
+    std::string freshRequest(const std::string& url) {
+        std::string buf;
+        curl_global_init(CURL_GLOBAL_ALL);
+        CURL* curl = curl_easy_init();
+        if (curl) {
+            curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+            curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, "GET");
+            curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, writeCallback);
+            curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0L);
+            curl_easy_setopt(curl, CURLOPT_WRITEDATA, &buf);
+            curl_easy_perform(curl);
+            curl_easy_cleanup(curl);
+        }
+        curl_global_cleanup();
+        return buf;
+    }
+
+    template <typename Request>
+    void measure(const char* name, int requests, const std::string& url, Request request) {
+        std::vector<int64_t> latencies;
+        latencies.reserve(requests);
+        int failed = 0;
+        for (int i = 0; i < requests; i++) {
+            int64_t start = bench::monotonicNs();
+            std::string response = request(url);
+            latencies.push_back(bench::monotonicNs() - start);
+            if (response != responseBody)
+                failed++;
+        }
+        bench::reportLatencies(name, latencies);
+        char label[64];
+        snprintf(label, sizeof(label), "%s.failed", name);
+        bench::report(label, failed, "");
+    }
+}  // namespace
+
+int main(int argc, char** argv) {
+    int requests = 200;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--requests") == 0 && i + 1 < argc)
+            requests = atoi(argv[++i]);
+        else {
+            fprintf(stderr, "usage: %s [--requests n]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    bench::LocalServer server([](const std::string&) { return responseBody; });
+    if (!server.port()) {
+        fprintf(stderr, "bench_http: couldn't listen on loopback\n");
+        return 1;
+    }
+    std::string url = server.url("/search?media=music&entity=song&term=artist");
+
+    measure("http.fresh", requests, url, freshRequest);
+    // the first pooled request pays for curl_global_init and the connect, like the first lookup after startup does
+    HttpClient::get().request(url);
+    measure("http.pooled", requests, url, [](const std::string& url) { return HttpClient::get().request(url); });
+
+    // the server threads never return, skip the static destructors
+    std::fflush(stdout);
+    std::_Exit(0);
+}
@@ -0,0 +1,207 @@
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../src/scrobbler.hpp"
+#include "bench.hpp"
+#include "local_server.hpp"
+
+// ScrobbleQueue against a mock last.fm endpoint that answers with a scripted sequence of errors: a failed login,
+// every retryable status once, an invalid session key that needs a new login, and a batch rejected for good. Checks
+// that the queue batches, backs off with doubling delays, logs in again and ends up with exactly the scrobbles the
+// mock accepted gone from the journal. Fails the run if it doesn't.
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    // what the mock answers, in order, "" for a dropped response. Everything after the script succeeds.
+    const std::vector<std::string> loginScript = {R"({"error":11,"message":"Service Offline"})"};
+    const std::vector<std::string> scrobbleScript = {
+        R"({"error":11,"message":"Service Offline"})",
+        R"({"error":29,"message":"Rate Limit Exceeded"})",
+        R"({"error":9,"message":"Invalid session key"})",
+        "",
+        R"({"scrobbles":{}})",
+        R"({"scrobbles":{}})",
+        R"({"error":6,"message":"Invalid parameters"})",
+    };
+    const int scrobbleCount = 170;
+    const size_t rejectedCall = 6;  // the batch that got the invalid parameters
+
+    struct Call {
+        Clock::time_point at;
+        std::vector<int64_t> timestamps;
+        bool failed;
+    };
+
+    std::mutex mutex;
+    std::vector<Clock::time_point> logins;
+    std::vector<Call> scrobbleCalls;
+
+    std::string decode(const std::string& text) {
+        std::string out;
+        for (size_t i = 0; i < text.size(); i++) {
+            if (text[i] == '+')
+                out += ' ';
+            else if (text[i] == '%' && i + 2 < text.size()) {
+                out += static_cast<char>(std::strtol(text.substr(i + 1, 2).c_str(), nullptr, 16));
+                i += 2;
+            } else
+                out += text[i];
+        }
+        return out;
+    }
+
+    std::string handle(const std::string& body) {
+        std::string method;
+        std::vector<int64_t> timestamps;
+        size_t begin = 0;
+        while (begin <= body.size()) {
+            size_t end = body.find('&', begin);
+            if (end == std::string::npos)
+                end = body.size();
+            std::string pair = body.substr(begin, end - begin);
+            size_t equals = pair.find('=');
+            std::string key = decode(pair.substr(0, equals));
+            std::string value = equals == std::string::npos ? "" : decode(pair.substr(equals + 1));
+            if (key == "method")
+                method = value;
+            else if (key.compare(0, 10, "timestamp[") == 0)
+                timestamps.push_back(std::stoll(value));
+            begin = end + 1;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (method == "auth.getMobileSession") {
+            logins.push_back(Clock::now());
+            if (logins.size() <= loginScript.size())
+                return loginScript[logins.size() - 1];
+            return R"({"session":{"name":"bench","key":"session","subscriber":0}})";
+        }
+        if (method == "track.scrobble") {
+            size_t index = scrobbleCalls.size();
+            std::string response = index < scrobbleScript.size() ? scrobbleScript[index] : R"({"scrobbles":{}})";
+            bool failed = response.empty() || response.find("error") != std::string::npos;
+            scrobbleCalls.push_back({Clock::now(), std::move(timestamps), failed});
+            return response;
+        }
+        return R"({"error":3,"message":"Invalid Method"})";
+    }
+
+    int failures = 0;
+    void check(bool ok, const char* what) {
+        if (ok)
+            return;
+        fprintf(stderr, "bench_lastfm: %s\n", what);
+        failures++;
+    }
+
+    int64_t ms(Clock::duration duration) {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(duration).count();
+    }
+}  // namespace
+
+int main(int argc, char** argv) {
+    int minBackoffMs = 100;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--min-backoff-ms") == 0 && i + 1 < argc)
+            minBackoffMs = atoi(argv[++i]);
+        else {
+            fprintf(stderr, "usage: %s [--min-backoff-ms ms]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    bench::LocalServer server(handle);
+    if (!server.port()) {
+        fprintf(stderr, "bench_lastfm: couldn't listen on loopback\n");
+        return 1;
+    }
+    std::filesystem::path journal =
+        std::filesystem::temp_directory_path() / ("bench_lastfm_" + std::to_string(getpid()) + ".tsv");
+    std::filesystem::remove(journal);
+
+    std::chrono::milliseconds minBackoff(minBackoffMs);
+    auto queue = std::make_unique<ScrobbleQueue>(journal, minBackoff, std::chrono::seconds(60));
+    // queued before there is a client, the queue has to hold on to them until it gets one
+    for (int i = 1; i <= scrobbleCount; i++)
+        queue->enqueue({"artist " + std::to_string(i), "track " + std::to_string(i), "album", i, 200});
+    check(queue->size() == scrobbleCount, "scrobbles enqueued without a client got lost");
+
+    int64_t start = bench::monotonicNs();
+    queue->setClient(std::make_shared<LastFM>("bench", "password", "key", "secret", server.url("/2.0/")));
+    auto deadline = Clock::now() + std::chrono::seconds(30);
+    while (Clock::now() < deadline && queue->size() > 0)
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    double drainMs = (bench::monotonicNs() - start) / 1e6;
+    size_t left = queue->size();
+    queue.reset();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    check(left == 0, "the queue never drained");
+
+    // one failed login, one that worked, one more after the invalid session key
+    check(logins.size() == 3, "expected 3 logins");
+    if (logins.size() >= 2)
+        check(logins[1] - logins[0] >= minBackoff, "the failed login was retried without backing off");
+
+    check(scrobbleCalls.size() == scrobbleScript.size() + 1, "unexpected number of track.scrobble calls");
+    std::set<int64_t> accepted;
+    size_t acceptedCount = 0;
+    for (size_t i = 0; i < scrobbleCalls.size(); i++) {
+        const Call& call = scrobbleCalls[i];
+        check(!call.timestamps.empty() && call.timestamps.size() <= LastFM::MAX_SCROBBLE_BATCH, "bad batch size");
+        if (!call.failed) {
+            accepted.insert(call.timestamps.begin(), call.timestamps.end());
+            acceptedCount += call.timestamps.size();
+        }
+        if (i == 0)
+            continue;
+
+        // every failure doubles the wait before the next try, success resets it
+        const Call& previous = scrobbleCalls[i - 1];
+        auto gap = call.at - previous.at;
+        if (previous.failed && i - 1 != rejectedCall) {
+            auto expected = minBackoff * (1 << (i - 1));
+            check(gap >= expected - std::chrono::milliseconds(5), "retried before the backoff was over");
+            check(gap < expected * 3 / 2 + std::chrono::milliseconds(250), "backed off for too long");
+        } else
+            check(gap < minBackoff, "waited after a batch went through");
+    }
+
+    // everything but the rejected batch, each exactly once
+    std::set<int64_t> expected;
+    for (int i = 1; i <= scrobbleCount; i++) expected.insert(i);
+    if (rejectedCall < scrobbleCalls.size()) {
+        for (int64_t timestamp : scrobbleCalls[rejectedCall].timestamps) expected.erase(timestamp);
+    }
+    check(accepted == expected, "the accepted scrobbles don't match what was enqueued");
+    check(acceptedCount == accepted.size(), "a scrobble was accepted twice");
+
+    std::error_code error;
+    check(std::filesystem::file_size(journal, error) == 0 && !error, "the journal still has entries");
+    std::filesystem::remove(journal, error);
+
+    bench::report("lastfm.logins", static_cast<double>(logins.size()), "");
+    bench::report("lastfm.scrobble_calls", static_cast<double>(scrobbleCalls.size()), "");
+    bench::report("lastfm.accepted", static_cast<double>(accepted.size()), "");
+    for (size_t i = 1; i < scrobbleCalls.size(); i++) {
+        char label[64];
+        snprintf(label, sizeof(label), "lastfm.retry_gap.%zu", i);
+        bench::report(label, static_cast<double>(ms(scrobbleCalls[i].at - scrobbleCalls[i - 1].at)), "ms");
+    }
+    bench::report("lastfm.drain_time", drainMs, "ms");
+    bench::report("lastfm.failed_checks", failures, "");
+
+    // the server threads never return, skip the static destructors
+    std::fflush(stdout);
+    std::_Exit(failures ? 1 : 0);
+}
@@ -0,0 +1,55 @@
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <thread>
+
+#include "../src/backend.hpp"
+#include "../src/pipeline.hpp"
+#include "bench.hpp"
+#include "discord_stub.hpp"
+
+// runs the whole pipeline against mock_player with discord stubbed out and reports how long a track change takes to
+// end up in Discord_UpdatePresence. The presence manager holds updates back for its rate window, so churn faster than
+// that shows up as coalescing, not as a slow pipeline.
+int main(int argc, char** argv) {
+    int seconds = 30;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc)
+            seconds = atoi(argv[++i]);
+        else {
+            fprintf(stderr, "usage: %s [--seconds s]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    // keep the benchmark away from the real settings, scrobble journal and artwork cache
+    std::filesystem::path home = std::filesystem::temp_directory_path() / "playerlink-bench";
+    std::filesystem::remove_all(home);
+    std::filesystem::create_directories(home);
+    setenv("HOME", home.c_str(), 1);
+
+    if (!backend::init()) {
+        fprintf(stderr, "bench_pipeline: backend::init() failed, is DBUS_SESSION_BUS_ADDRESS set?\n");
+        return 1;
+    }
+
+    pipeline::Options options;
+    options.scrobbling = false;
+    int64_t cpuBefore = bench::cpuTimeUs();
+    pipeline::start(options);
+    std::this_thread::sleep_for(std::chrono::seconds(seconds));
+    double cpuSeconds = (bench::cpuTimeUs() - cpuBefore) / 1e6;
+
+    discordStub::Stats stats = discordStub::stats();
+    bench::reportLatencies("pipeline.change_to_presence", stats.latenciesNs);
+    bench::report("pipeline.presence_updates", static_cast<double>(stats.updates), "");
+    bench::report("pipeline.presence_clears", static_cast<double>(stats.clears), "");
+    bench::report("pipeline.discord_inits", static_cast<double>(stats.initializations), "");
+    bench::report("pipeline.cpu_per_hour", seconds ? cpuSeconds * 3600 / seconds : 0, "s");
+
+    pipeline::stop();
+    std::fflush(stdout);
+    std::_Exit(0);
+}
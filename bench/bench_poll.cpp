@@ -0,0 +1,153 @@
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <new>
+#include <thread>
+
+#include "../src/mediasource.hpp"
+#include "../src/trackkey.hpp"
+#include "bench.hpp"
+
+// allocations of the pipeline's poll path, track changes included: the watcher asks a BackendSource for the new
+// state and swaps it into the slot, the loop side swaps it out again and checks for a new track. Allocations are
+// counted per thread, the backend's own dbus thread allocates while handling signals and isn't part of a poll. Expects
+// mock_player on the session bus, with churn so there are track changes to see.
+
+namespace {
+    thread_local uint64_t allocations = 0;
+}
+
+void* operator new(size_t size) {
+    allocations++;
+    if (void* p = std::malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+
+namespace {
+    // the slot from pipeline.cpp, with a condition variable standing in for posting to the event loop
+    std::mutex slotMutex;
+    std::condition_variable slotSignal;
+    MediaInfo slot;
+    bool slotPlaying = false;
+    bool slotPending = false;
+    bool stopping = false;
+    std::atomic<bool> measuring{false};
+
+    struct LoopResult {
+        uint64_t updates = 0;
+        uint64_t trackChanges = 0;
+        uint64_t allocations = 0;
+        uint64_t trackChangeAllocations = 0;
+    };
+
+    void runLoop(LoopResult& result) {
+        MediaInfo current;
+        TrackKey lastTrack;
+        while (true) {
+            uint64_t allocationsBefore = allocations;
+            bool playing;
+            {
+                std::unique_lock<std::mutex> lock(slotMutex);
+                slotSignal.wait(lock, [] { return slotPending || stopping; });
+                if (stopping)
+                    return;
+                std::swap(current, slot);
+                playing = slotPlaying;
+                slotPending = false;
+            }
+            bool changed = playing && !lastTrack.matches(current);
+            if (changed)
+                lastTrack.assign(current);
+
+            if (!measuring)
+                continue;
+            uint64_t allocated = allocations - allocationsBefore;
+            result.updates++;
+            result.allocations += allocated;
+            if (changed) {
+                result.trackChanges++;
+                result.trackChangeAllocations += allocated;
+            }
+        }
+    }
+}  // namespace
+
+int main(int argc, char** argv) {
+    int seconds = 20;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc)
+            seconds = atoi(argv[++i]);
+        else {
+            fprintf(stderr, "usage: %s [--seconds s]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    if (!backend::init()) {
+        fprintf(stderr, "bench_poll: backend::init() failed, is DBUS_SESSION_BUS_ADDRESS set?\n");
+        return 1;
+    }
+    BackendSource source;
+    MediaInfo media;
+    LoopResult loopResult;
+    std::thread loop(runLoop, std::ref(loopResult));
+
+    uint64_t polls = 0;
+    uint64_t pollAllocations = 0;
+    auto watch = [&](std::chrono::steady_clock::time_point end) {
+        while (std::chrono::steady_clock::now() < end) {
+            if (!source.waitForMediaChange(std::chrono::milliseconds(100)))
+                continue;
+            uint64_t allocationsBefore = allocations;
+            bool playing = source.getMediaInformation(media);
+            bool wasPending;
+            {
+                std::lock_guard<std::mutex> lock(slotMutex);
+                std::swap(media, slot);
+                slotPlaying = playing;
+                wasPending = slotPending;
+                slotPending = true;
+            }
+            if (!wasPending)
+                slotSignal.notify_one();
+            if (measuring) {
+                pollAllocations += allocations - allocationsBefore;
+                polls++;
+            }
+        }
+    };
+
+    // the first rounds grow the buffers on both sides of the slot, they don't count
+    watch(std::chrono::steady_clock::now() + std::chrono::seconds(2));
+    measuring = true;
+    watch(std::chrono::steady_clock::now() + std::chrono::seconds(seconds));
+    {
+        std::lock_guard<std::mutex> lock(slotMutex);
+        stopping = true;
+    }
+    slotSignal.notify_one();
+    loop.join();
+
+    bench::report("slot.polls", static_cast<double>(polls), "");
+    bench::report("slot.allocations", polls ? static_cast<double>(pollAllocations) / polls : 0, "per poll");
+    bench::report("slot.loop_updates", static_cast<double>(loopResult.updates), "");
+    bench::report("slot.loop_allocations",
+                  loopResult.updates ? static_cast<double>(loopResult.allocations) / loopResult.updates : 0,
+                  "per update");
+    bench::report("slot.track_changes", static_cast<double>(loopResult.trackChanges), "");
+    bench::report("slot.track_change_allocations",
+                  loopResult.trackChanges
+                      ? static_cast<double>(loopResult.trackChangeAllocations) / loopResult.trackChanges
+                      : 0,
+                  "per change");
+
+    // the backend's dbus thread is still running, skip the static destructors
+    std::fflush(stdout);
+    std::_Exit(0);
+}
@@ -0,0 +1,117 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <future>
+#include <thread>
+#include <vector>
+
+#include "../src/backend.hpp"
+#include "../src/discord.hpp"
+#include "../src/scheduler.hpp"
+#include "bench.hpp"
+#include "fake_discord.hpp"
+
+// drives DiscordConnection against FakeDiscord the same way the pipeline does: pumped once a second on an event loop
+// and right away when the socket shows up. Reports how long it takes to get connected after discord starts, after it
+// restarts and after switching to another client id.
+
+namespace {
+    EventLoop eventLoop;
+    DiscordConnection connection;
+    std::function<void()> pump = [] { connection.pump(); };
+
+    template <typename F>
+    auto onLoop(F&& task) {
+        std::promise<decltype(task())> result;
+        eventLoop.post([&] { result.set_value(task()); });
+        return result.get_future().get();
+    }
+
+    // time until discord sent READY for the given client id, counted from start
+    int64_t waitForReady(FakeDiscord& discord, int64_t start, const std::string& clientId, uint64_t handshakesBefore) {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(120);
+        while (std::chrono::steady_clock::now() < deadline) {
+            FakeDiscord::Stats stats = discord.stats();
+            if (stats.handshakes > handshakesBefore && stats.clientId == clientId)
+                return stats.readyAtNs - start;
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        return -1;
+    }
+}  // namespace
+
+int main(int argc, char** argv) {
+    int rounds = 20;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--rounds") == 0 && i + 1 < argc)
+            rounds = atoi(argv[++i]);
+        else {
+            fprintf(stderr, "usage: %s [--rounds n]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    // discord-rpc looks for its socket in XDG_RUNTIME_DIR, so a private one keeps the real discord out of this
+    std::filesystem::path runtimeDirectory = std::filesystem::temp_directory_path() / "playerlink-bench-rpc";
+    std::filesystem::remove_all(runtimeDirectory);
+    std::filesystem::create_directories(runtimeDirectory);
+    setenv("XDG_RUNTIME_DIR", runtimeDirectory.c_str(), 1);
+    FakeDiscord discord((runtimeDirectory / "discord-ipc-0").string());
+
+    std::thread([] { eventLoop.run(); }).detach();
+    eventLoop.every(std::chrono::seconds(1), pump);
+    backend::watchDiscordSocket([] {
+        connection.socketAppeared();
+        eventLoop.post(pump);
+    });
+
+    // discord starts a while after us, the first attempts fail and back off
+    onLoop([] {
+        connection.setClientId("1000");
+        return true;
+    });
+    eventLoop.post(pump);
+    std::this_thread::sleep_for(std::chrono::seconds(8));
+    int64_t start = bench::monotonicNs();
+    discord.start();
+    int64_t latency = waitForReady(discord, start, "1000", 0);
+    bench::report("rpc.start_to_ready", latency / 1e6, "ms");
+
+    // switching apps, the old connection has to go before the new id can connect
+    std::vector<int64_t> switches;
+    for (int i = 0; i < rounds; i++) {
+        std::string clientId = std::to_string(1001 + i);
+        uint64_t handshakes = discord.stats().handshakes;
+        start = bench::monotonicNs();
+        onLoop([&clientId] {
+            connection.setClientId(clientId);
+            return true;
+        });
+        switches.push_back(waitForReady(discord, start, clientId, handshakes));
+    }
+    bench::reportLatencies("rpc.switch_to_ready", switches);
+
+    // discord restarting, e.g. after an update
+    std::vector<int64_t> restarts;
+    for (int i = 0; i < std::min(rounds, 5); i++) {
+        std::string clientId = onLoop([]() -> std::string { return connection.getClientId(); });
+        discord.stop();
+        std::this_thread::sleep_for(std::chrono::seconds(3));
+        uint64_t handshakes = discord.stats().handshakes;
+        start = bench::monotonicNs();
+        discord.start();
+        restarts.push_back(waitForReady(discord, start, clientId, handshakes));
+    }
+    bench::reportLatencies("rpc.restart_to_ready", restarts);
+
+    onLoop([] {
+        connection.shutdown();
+        return true;
+    });
+    discord.stop();
+    std::fflush(stdout);
+    std::_Exit(0);
+}
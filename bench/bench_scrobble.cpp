@@ -0,0 +1,142 @@
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "../src/scrobbler.hpp"
+#include "bench.hpp"
+
+// feeds scripted MediaInfo sequences to ScrobbleTracker and checks that nowPlaying and scrobble fire exactly where
+// last.fm's rules say they should: half the length or 4 minutes, nothing for tracks of 30 seconds or less, and only
+// time spent playing counts, not pauses, seeks or the time nothing was playing. feed() gets the timestamps from the
+// script, so this runs in no time and always the same way. Fails the run on any mismatch.
+
+namespace {
+    struct Step {
+        int64_t at;         // seconds since the start of the scenario
+        const char* title;  // nullptr: nothing is playing anymore
+        int64_t duration;   // seconds
+        int64_t elapsed;    // seconds, what the player reports
+        bool paused;
+        const char* expect;  // "", "now playing", "scrobble" or "now playing, scrobble"
+    };
+
+    struct Scenario {
+        const char* name;
+        std::vector<Step> steps;
+    };
+
+    const std::vector<Scenario> scenarios = {
+        {"half the length",
+         {{0, "Song", 200, 0, false, "now playing"},
+          {50, "Song", 200, 50, false, ""},
+          {99, "Song", 200, 99, false, ""},
+          {100, "Song", 200, 100, false, "scrobble"},
+          {150, "Song", 200, 150, false, ""}}},
+        {"4 minutes at most",
+         {{0, "Song", 600, 0, false, "now playing"},
+          {239, "Song", 600, 239, false, ""},
+          {240, "Song", 600, 240, false, "scrobble"}}},
+        {"30 seconds or less never counts",
+         {{0, "Jingle", 30, 0, false, "now playing"}, {30, "Jingle", 30, 30, false, ""}}},
+        {"unknown length and no position, the wall clock counts",
+         {{0, "Stream", 0, 0, false, "now playing"},
+          {239, "Stream", 0, 0, false, ""},
+          {240, "Stream", 0, 0, false, "scrobble"}}},
+        {"paused time doesn't count",
+         {{0, "Song", 200, 0, false, "now playing"},
+          {60, "Song", 200, 60, true, ""},
+          {200, "Song", 200, 60, true, ""},
+          {201, "Song", 200, 60, false, "now playing"},
+          {240, "Song", 200, 99, false, ""},
+          {241, "Song", 200, 100, false, "scrobble"}}},
+        {"seeking forward doesn't count",
+         {{0, "Song", 400, 0, false, "now playing"},
+          {150, "Song", 400, 150, false, ""},
+          {151, "Song", 400, 300, false, ""},
+          {199, "Song", 400, 348, false, ""},
+          {200, "Song", 400, 349, false, "scrobble"}}},
+        {"seeking back doesn't count twice or restart the play",
+         {{0, "Song", 200, 0, false, "now playing"},
+          {80, "Song", 200, 80, false, ""},
+          {81, "Song", 200, 10, false, ""},
+          {100, "Song", 200, 29, false, ""},
+          {101, "Song", 200, 30, false, "scrobble"}}},
+        {"time with nothing playing doesn't count",
+         {{0, "Song", 200, 0, false, "now playing"},
+          {50, "Song", 200, 50, false, ""},
+          {51, nullptr, 0, 0, false, ""},
+          {300, "Song", 200, 50, false, "now playing"},
+          {349, "Song", 200, 99, false, ""},
+          {350, "Song", 200, 100, false, "scrobble"}}},
+        {"a repeat of the same track is a new play",
+         {{0, "Song", 200, 0, false, "now playing"},
+          {100, "Song", 200, 100, false, "scrobble"},
+          {199, "Song", 200, 199, false, ""},
+          {200, "Song", 200, 0, false, "now playing"},
+          {300, "Song", 200, 100, false, "scrobble"}}},
+        {"seeking back after the scrobble isn't a repeat",
+         {{0, "Song", 200, 0, false, "now playing"},
+          {100, "Song", 200, 100, false, "scrobble"},
+          {101, "Song", 200, 50, false, ""},
+          {200, "Song", 200, 149, false, ""}}},
+        {"another track starts a new play",
+         {{0, "Song", 200, 0, false, "now playing"},
+          {90, "Song", 200, 90, false, ""},
+          {91, "Other Song", 200, 0, false, "now playing"},
+          {190, "Other Song", 200, 99, false, ""},
+          {191, "Other Song", 200, 100, false, "scrobble"}}},
+        {"case and whitespace don't make another track",
+         {{0, "Song", 200, 0, false, "now playing"},
+          {50, " SONG ", 200, 50, false, ""},
+          {100, "song", 200, 100, false, "scrobble"}}},
+        {"a track that starts paused is announced once it plays",
+         {{0, "Song", 200, 0, true, ""},
+          {10, "Song", 200, 0, false, "now playing"},
+          {110, "Song", 200, 100, false, "scrobble"}}},
+    };
+
+    std::string describe(const ScrobbleTracker::Events& events) {
+        if (events.nowPlaying && events.scrobble)
+            return "now playing, scrobble";
+        if (events.nowPlaying)
+            return "now playing";
+        return events.scrobble ? "scrobble" : "";
+    }
+}  // namespace
+
+int main() {
+    int failures = 0;
+    size_t steps = 0;
+    auto start = ScrobbleTracker::Clock::now();
+    for (const auto& scenario : scenarios) {
+        ScrobbleTracker tracker;
+        MediaInfo media;
+        for (const auto& step : scenario.steps) {
+            steps++;
+            if (!step.title) {
+                tracker.stop();
+                continue;
+            }
+            media.songTitle = step.title;
+            media.songArtist = "Artist";
+            media.songAlbum = "Album";
+            media.songDuration = step.duration * 1000;
+            media.songElapsedTime = step.elapsed * 1000;
+            media.paused = step.paused;
+
+            std::string events = describe(tracker.feed(media, start + std::chrono::seconds(step.at)));
+            if (events != step.expect) {
+                fprintf(stderr, "bench_scrobble: %s, at %llds: expected \"%s\", got \"%s\"\n", scenario.name,
+                        static_cast<long long>(step.at), step.expect, events.c_str());
+                failures++;
+            }
+        }
+    }
+
+    bench::report("scrobble.scenarios", static_cast<double>(scenarios.size()), "");
+    bench::report("scrobble.steps", static_cast<double>(steps), "");
+    bench::report("scrobble.mismatches", failures, "");
+    return failures ? 1 : 0;
+}
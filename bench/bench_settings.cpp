@@ -0,0 +1,86 @@
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <thread>
+
+#include "../src/backend.hpp"
+#include "../src/utils.hpp"
+#include "bench.hpp"
+
+// types into the last.fm username the way the settings window does, one updateSettings() per keystroke, while another
+// thread keeps reading settings.json. Reports how many times the file got written and whether a reader ever saw it
+// half written.
+int main(int argc, char** argv) {
+    int keystrokes = 200;
+    int intervalMs = 5;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--keystrokes") == 0 && i + 1 < argc)
+            keystrokes = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--interval-ms") == 0 && i + 1 < argc)
+            intervalMs = atoi(argv[++i]);
+        else {
+            fprintf(stderr, "usage: %s [--keystrokes n] [--interval-ms ms]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    std::filesystem::path home = std::filesystem::temp_directory_path() / "playerlink-bench-settings";
+    std::filesystem::remove_all(home);
+    std::filesystem::create_directories(home);
+    setenv("HOME", home.c_str(), 1);
+    std::filesystem::path file = backend::getConfigDirectory() / "settings.json";
+
+    utils::getSettings();  // writes the defaults
+    utils::flushSettings();
+    uint64_t writesBefore = utils::settingsWriter().writeCount();
+
+    std::atomic<bool> reading{true};
+    std::atomic<uint64_t> reads{0};
+    std::atomic<uint64_t> tornReads{0};
+    std::thread reader([&] {
+        std::string contents;
+        utils::Settings settings;
+        while (reading) {
+            if (!atomicfile::read(file, contents))
+                continue;  // in between the rename and the open on some filesystems, not a torn read
+            reads++;
+            if (!utils::parseSettings(contents, settings))
+                tornReads++;
+        }
+    });
+
+    std::string username = "a-user-name-that-is-typed-in-one-letter-at-a-time-";
+    std::string typed;
+    int64_t start = bench::monotonicNs();
+    for (int i = 0; i < keystrokes; i++) {
+        typed += username[i % username.size()];
+        utils::updateSettings([&typed](utils::Settings& settings) { settings.lastfm.username = typed; });
+        std::this_thread::sleep_for(std::chrono::milliseconds(intervalMs));
+    }
+    double typingMs = (bench::monotonicNs() - start) / 1e6;
+
+    start = bench::monotonicNs();
+    utils::flushSettings();
+    double flushMs = (bench::monotonicNs() - start) / 1e6;
+    reading = false;
+    reader.join();
+
+    std::string contents;
+    utils::Settings saved;
+    bool complete = atomicfile::read(file, contents) && utils::parseSettings(contents, saved) &&
+                    saved.lastfm.username == typed;
+
+    bench::report("settings.keystrokes", keystrokes, "");
+    bench::report("settings.typing_time", typingMs, "ms");
+    bench::report("settings.writes", static_cast<double>(utils::settingsWriter().writeCount() - writesBefore), "");
+    bench::report("settings.flush", flushMs, "ms");
+    bench::report("settings.reads", static_cast<double>(reads), "");
+    bench::report("settings.torn_reads", static_cast<double>(tornReads), "");
+    bench::report("settings.last_edit_saved", complete ? 1 : 0, "");
+
+    std::fflush(stdout);
+    std::_Exit(0);  // the config file watcher is still blocked in read()
+}
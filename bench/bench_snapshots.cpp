@@ -0,0 +1,79 @@
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../src/nowplaying.hpp"
+#include "bench.hpp"
+
+// the pipeline publishes NowPlaying snapshots while the tray reads them from the gui thread. Built with
+// ThreadSanitizer, so a race in the publish/read path fails the run instead of only showing up as a rare crash. Every
+// snapshot carries the same counter in all of its fields, a reader that sees two different ones got a torn snapshot.
+int main(int argc, char** argv) {
+    int publishes = 20000;
+    int readers = 4;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--publishes") == 0 && i + 1 < argc)
+            publishes = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--readers") == 0 && i + 1 < argc)
+            readers = atoi(argv[++i]);
+        else {
+            fprintf(stderr, "usage: %s [--publishes n] [--readers n]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    NowPlayingState state;
+    state.update([](NowPlaying& next) {
+        next.title = "artist - 0";
+        next.source = "source 0";
+        next.songInfo.trackId = 0;
+        return true;
+    });
+    std::atomic<bool> publishing{true};
+    std::atomic<uint64_t> reads{0};
+    std::atomic<uint64_t> tornReads{0};
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < readers; i++) {
+        threads.emplace_back([&] {
+            uint64_t ownReads = 0;
+            while (publishing) {
+                auto snapshot = state.get();
+                ownReads++;
+                std::string id = std::to_string(snapshot->songInfo.trackId);
+                if (snapshot->title != "artist - " + id || snapshot->source != "source " + id)
+                    tornReads++;
+            }
+            reads += ownReads;
+        });
+    }
+
+    // the same two kinds of change the pipeline makes: a new track, then the artwork lookup coming back
+    int64_t start = bench::monotonicNs();
+    for (int i = 0; i < publishes; i++) {
+        std::string id = std::to_string(i);
+        state.update([&id, i](NowPlaying& next) {
+            next.title = "artist - " + id;
+            next.source = "source " + id;
+            next.songInfo.trackId = i;
+            return true;
+        });
+        state.update([](NowPlaying& next) {
+            next.songInfo.artworkURL = "https://example.com/cover.jpg";
+            return true;
+        });
+    }
+    double publishMs = (bench::monotonicNs() - start) / 1e6;
+    publishing = false;
+    for (auto& thread : threads) thread.join();
+
+    bench::report("snapshots.publishes", publishes * 2.0, "");
+    bench::report("snapshots.publish_time", publishMs, "ms");
+    bench::report("snapshots.readers", readers, "");
+    bench::report("snapshots.reads", static_cast<double>(reads), "");
+    bench::report("snapshots.torn_reads", static_cast<double>(tornReads), "");
+    return tornReads ? 1 : 0;
+}
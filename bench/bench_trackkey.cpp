@@ -0,0 +1,92 @@
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+
+#include "../src/scrobbler.hpp"
+#include "../src/trackkey.hpp"
+#include "bench.hpp"
+
+// what telling tracks apart costs on every poll. "concat" is how the pipeline used to do it, building one string out
+// of title, artist, album and duration and comparing that, "match" is TrackKey. A steady state poll (key match plus
+// scrobble tracker feed) and assigning a new track to a warmed up key should both stay at 0 allocations.
+
+namespace {
+    std::atomic<uint64_t> allocations{0};
+    volatile uint64_t sink;
+}
+
+void* operator new(size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+
+namespace {
+    // runs body iterations times, prints nanoseconds and allocations per iteration
+    template <typename Body>
+    void measure(const char* name, int iterations, Body body) {
+        uint64_t allocationsBefore = allocations.load(std::memory_order_relaxed);
+        int64_t start = bench::monotonicNs();
+        for (int i = 0; i < iterations; i++) body(i);
+        int64_t elapsed = bench::monotonicNs() - start;
+        uint64_t allocated = allocations.load(std::memory_order_relaxed) - allocationsBefore;
+
+        char label[64];
+        snprintf(label, sizeof(label), "%s.time", name);
+        bench::report(label, iterations ? static_cast<double>(elapsed) / iterations : 0, "ns");
+        snprintf(label, sizeof(label), "%s.allocations", name);
+        bench::report(label, iterations ? static_cast<double>(allocated) / iterations : 0, "per call");
+    }
+}  // namespace
+
+int main(int argc, char** argv) {
+    int iterations = 1000000;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--iterations") == 0 && i + 1 < argc)
+            iterations = atoi(argv[++i]);
+        else {
+            fprintf(stderr, "usage: %s [--iterations n]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    // long enough that none of the fields fit into the small string buffer
+    MediaInfo tracks[2] = {
+        MediaInfo(false, "Everything In Its Right Place", "Radiohead", "Kid A (Remastered Edition)", "spotify", "",
+                  251000, 0),
+        MediaInfo(false, "The National Anthem", "Radiohead", "Kid A (Remastered Edition)", "spotify", "", 351000, 0),
+    };
+    MediaInfo& media = tracks[0];
+
+    std::string lastKey = media.songTitle + media.songArtist + media.songAlbum + std::to_string(media.songDuration);
+    measure("trackkey.concat", iterations, [&](int) {
+        std::string key = media.songTitle + media.songArtist + media.songAlbum + std::to_string(media.songDuration);
+        sink = key == lastKey;
+    });
+
+    TrackKey key(media);
+    measure("trackkey.match", iterations, [&](int) { sink = key.matches(media); });
+
+    // the same track playing on, one poll a second
+    ScrobbleTracker tracker;
+    auto now = ScrobbleTracker::Clock::now();
+    tracker.feed(media, now);
+    measure("trackkey.poll", iterations, [&](int i) {
+        media.songElapsedTime = static_cast<int64_t>(i) * 1000;
+        if (!key.matches(media))
+            key.assign(media);
+        sink = tracker.feed(media, now + std::chrono::seconds(i)).scrobble;
+    });
+
+    // alternating between two tracks, after the first round the key's strings are big enough for both
+    key.assign(tracks[1]);
+    key.assign(tracks[0]);
+    measure("trackkey.assign", iterations, [&](int i) { key.assign(tracks[i & 1]); });
+
+    return 0;
+}
@@ -0,0 +1,63 @@
+#include "discord_stub.hpp"
+
+#include <discord-rpc/discord_rpc.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <string>
+
+#include "bench.hpp"
+
+namespace {
+    std::mutex mutex;
+    discordStub::Stats current;
+    std::string lastAlbum;
+    bool connected = false;
+}  // namespace
+
+discordStub::Stats discordStub::stats() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return current;
+}
+
+void Discord_Initialize(const char* applicationId, DiscordEventHandlers* handlers, int autoRegister,
+                        const char* optionalSteamId) {
+    std::lock_guard<std::mutex> lock(mutex);
+    current.initializations++;
+    connected = true;
+}
+
+void Discord_Shutdown(void) {
+    std::lock_guard<std::mutex> lock(mutex);
+    connected = false;
+}
+
+void Discord_RunCallbacks(void) {}
+
+bool Discord_IsConnected(void) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return connected;
+}
+
+void Discord_UpdatePresence(const DiscordRichPresence* presence) {
+    int64_t now = bench::monotonicNs();
+    std::lock_guard<std::mutex> lock(mutex);
+    current.updates++;
+
+    // mock_player puts the time of the track change into the album, only the first update of a track counts. The
+    // track that was already playing when the pipeline started didn't change while we watched, so it's skipped.
+    const char* album = presence->largeImageText ? presence->largeImageText : "";
+    const char* stamp = std::strchr(album, '@');
+    if (!stamp || lastAlbum == album)
+        return;
+    bool first = lastAlbum.empty();
+    lastAlbum = album;
+    if (!first)
+        current.latenciesNs.push_back(now - std::strtoll(stamp + 1, nullptr, 10));
+}
+
+void Discord_ClearPresence(void) {
+    std::lock_guard<std::mutex> lock(mutex);
+    current.clears++;
+}
@@ -0,0 +1,20 @@
+#ifndef _DISCORD_STUB_
+#define _DISCORD_STUB_
+
+#include <cstdint>
+#include <vector>
+
+// replaces discord-rpc in the pipeline benchmark. Nothing leaves the process, the stub only counts calls and measures
+// how long a track change took to reach Discord_UpdatePresence.
+namespace discordStub {
+    struct Stats {
+        uint64_t initializations = 0;
+        uint64_t updates = 0;
+        uint64_t clears = 0;
+        std::vector<int64_t> latenciesNs;  // track change in mock_player -> Discord_UpdatePresence
+    };
+
+    Stats stats();
+}  // namespace discordStub
+
+#endif
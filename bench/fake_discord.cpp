@@ -0,0 +1,146 @@
+#include "fake_discord.hpp"
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <nlohmann-json/single_include/nlohmann/json.hpp>
+
+#include "bench.hpp"
+
+namespace {
+    enum Opcode : uint32_t { HANDSHAKE = 0, FRAME = 1, CLOSE = 2, PING = 3, PONG = 4 };
+
+    bool writeFrame(int fd, uint32_t opcode, const std::string& payload) {
+        // little endian opcode and length in front of the json, every platform discord runs on is little endian
+        uint32_t header[2] = {opcode, static_cast<uint32_t>(payload.size())};
+        std::string frame(reinterpret_cast<const char*>(header), sizeof(header));
+        frame += payload;
+        return send(fd, frame.data(), frame.size(), MSG_NOSIGNAL) == static_cast<ssize_t>(frame.size());
+    }
+}  // namespace
+
+bool FakeDiscord::start() {
+    stop();
+    listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listenFd < 0)
+        return false;
+
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, socketPath.c_str(), sizeof(address.sun_path) - 1);
+    unlink(socketPath.c_str());
+    if (bind(listenFd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 || listen(listenFd, 4) < 0) {
+        close(listenFd);
+        listenFd = -1;
+        return false;
+    }
+
+    stopping = false;
+    worker = std::thread(&FakeDiscord::run, this);
+    return true;
+}
+
+void FakeDiscord::stop() {
+    if (!worker.joinable())
+        return;
+    stopping = true;
+    worker.join();
+    close(listenFd);
+    listenFd = -1;
+    unlink(socketPath.c_str());
+}
+
+FakeDiscord::Stats FakeDiscord::stats() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return current;
+}
+
+// one client at a time is all discord-rpc needs, a new connection replaces the old one
+void FakeDiscord::run() {
+    int client = -1;
+    std::string buffer;
+    while (!stopping) {
+        pollfd fds[2] = {{listenFd, POLLIN, 0}, {client, POLLIN, 0}};
+        if (poll(fds, client >= 0 ? 2 : 1, 20) <= 0)
+            continue;
+
+        if (fds[0].revents & POLLIN) {
+            int accepted = accept(listenFd, nullptr, nullptr);
+            if (accepted >= 0) {
+                if (client >= 0)
+                    close(client);
+                client = accepted;
+                buffer.clear();
+            }
+            continue;
+        }
+        if (client < 0 || !(fds[1].revents & (POLLIN | POLLHUP | POLLERR)))
+            continue;
+
+        char chunk[4096];
+        ssize_t length = recv(client, chunk, sizeof(chunk), 0);
+        if (length <= 0) {
+            close(client);
+            client = -1;
+            continue;
+        }
+        buffer.append(chunk, length);
+
+        while (buffer.size() >= 8) {
+            uint32_t header[2];
+            memcpy(header, buffer.data(), sizeof(header));
+            if (buffer.size() < 8 + header[1])
+                break;
+            std::string payload = buffer.substr(8, header[1]);
+            buffer.erase(0, 8 + header[1]);
+            if (!handleFrame(client, header[0], payload)) {
+                close(client);
+                client = -1;
+                break;
+            }
+        }
+    }
+    if (client >= 0)
+        close(client);
+}
+
+bool FakeDiscord::handleFrame(int client, uint32_t opcode, const std::string& payload) {
+    if (opcode == PING)
+        return writeFrame(client, PONG, payload);
+    if (opcode == CLOSE)
+        return false;
+
+    nlohmann::json message = nlohmann::json::parse(payload, nullptr, false);
+    if (message.is_discarded())
+        return false;
+
+    if (opcode == HANDSHAKE) {
+        nlohmann::json ready = {{"cmd", "DISPATCH"},
+                                {"evt", "READY"},
+                                {"data",
+                                 {{"v", 1},
+                                  {"config", {{"cdn_host", "cdn.discordapp.com"}, {"environment", "production"}}},
+                                  {"user", {{"id", "1"}, {"username", "bench"}, {"discriminator", "0"}}}}}};
+        bool sent = writeFrame(client, FRAME, ready.dump());
+        std::lock_guard<std::mutex> lock(mutex);
+        current.handshakes++;
+        current.clientId = message.value("client_id", "");
+        current.readyAtNs = bench::monotonicNs();
+        return sent;
+    }
+
+    // SET_ACTIVITY and friends, echo the arguments back like discord does
+    nlohmann::json reply = {{"cmd", message.value("cmd", "")},
+                            {"nonce", message.value("nonce", "")},
+                            {"evt", nullptr},
+                            {"data", message.value("args", nlohmann::json::object())}};
+    if (message.value("cmd", "") == "SET_ACTIVITY") {
+        std::lock_guard<std::mutex> lock(mutex);
+        current.activities++;
+        current.activityAtNs = bench::monotonicNs();
+    }
+    return writeFrame(client, FRAME, reply.dump());
+}
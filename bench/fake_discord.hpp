@@ -0,0 +1,46 @@
+#ifndef _FAKE_DISCORD_
+#define _FAKE_DISCORD_
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// just enough of discord's ipc protocol for discord-rpc to connect and set activities: answers the handshake with a
+// READY dispatch, acknowledges every command and replies to pings. Listens on a unix socket, the way discord does on
+// linux and mac os.
+class FakeDiscord {
+public:
+    struct Stats {
+        uint64_t handshakes = 0;
+        uint64_t activities = 0;
+        std::string clientId;  // of the last handshake
+        int64_t readyAtNs = 0;  // CLOCK_MONOTONIC time the last READY was sent
+        int64_t activityAtNs = 0;
+    };
+
+    explicit FakeDiscord(std::string socketPath) : socketPath(std::move(socketPath)) {}
+    ~FakeDiscord() { stop(); }
+
+    FakeDiscord(const FakeDiscord&) = delete;
+    FakeDiscord& operator=(const FakeDiscord&) = delete;
+
+    bool start();
+    // closes the socket and the client connection, like quitting discord
+    void stop();
+    Stats stats();
+
+private:
+    void run();
+    bool handleFrame(int client, uint32_t opcode, const std::string& payload);
+
+    std::string socketPath;
+    int listenFd = -1;
+    std::atomic<bool> stopping{false};
+    std::thread worker;
+    std::mutex mutex;
+    Stats current;
+};
+
+#endif
@@ -0,0 +1,87 @@
+#ifndef _LOCAL_SERVER_
+#define _LOCAL_SERVER_
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cstdlib>
+#include <functional>
+#include <string>
+#include <thread>
+
+// keep-alive http/1.1 server on a random loopback port, a stand-in for the web services the benchmarks talk to.
+// Every request gets a 200 with whatever the handler returns for its body. One thread per connection, so the handler
+// has to be thread safe. Never shuts down, the benchmarks end with _Exit.
+namespace bench {
+    class LocalServer {
+    public:
+        using Handler = std::function<std::string(const std::string& body)>;
+
+        explicit LocalServer(Handler handler) : handler(std::move(handler)) {
+            int fd = socket(AF_INET, SOCK_STREAM, 0);
+            int yes = 1;
+            setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+            sockaddr_in addr{};
+            addr.sin_family = AF_INET;
+            addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            socklen_t length = sizeof(addr);
+            if (fd < 0 || bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || listen(fd, 64) != 0 ||
+                getsockname(fd, reinterpret_cast<sockaddr*>(&addr), &length) != 0)
+                return;
+            listenPort = ntohs(addr.sin_port);
+            std::thread([this, fd] {
+                while (true) {
+                    int client = accept(fd, nullptr, nullptr);
+                    if (client >= 0)
+                        std::thread(&LocalServer::serve, this, client).detach();
+                }
+            }).detach();
+        }
+
+        LocalServer(const LocalServer&) = delete;
+        LocalServer& operator=(const LocalServer&) = delete;
+
+        // 0 if listening failed
+        int port() const { return listenPort; }
+        std::string url(const std::string& path = "/") const {
+            return "http://127.0.0.1:" + std::to_string(listenPort) + path;
+        }
+
+    private:
+        void serve(int fd) {
+            std::string pending;
+            char buf[4096];
+            while (true) {
+                size_t headerEnd = pending.find("\r\n\r\n");
+                size_t bodyLength = 0;
+                if (headerEnd != std::string::npos) {
+                    size_t field = pending.find("Content-Length:");
+                    if (field != std::string::npos && field < headerEnd)
+                        bodyLength = std::strtoul(pending.c_str() + field + 15, nullptr, 10);
+                }
+                if (headerEnd == std::string::npos || pending.size() < headerEnd + 4 + bodyLength) {
+                    ssize_t n = recv(fd, buf, sizeof(buf), 0);
+                    if (n <= 0)
+                        break;
+                    pending.append(buf, n);
+                    continue;
+                }
+
+                std::string body = handler(pending.substr(headerEnd + 4, bodyLength));
+                pending.erase(0, headerEnd + 4 + bodyLength);
+                std::string response = "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nContent-Length: " +
+                                       std::to_string(body.size()) + "\r\n\r\n" + body;
+                if (send(fd, response.data(), response.size(), MSG_NOSIGNAL) < 0)
+                    break;
+            }
+            close(fd);
+        }
+
+        Handler handler;
+        int listenPort = 0;
+    };
+}  // namespace bench
+
+#endif
@@ -0,0 +1,245 @@
+#include <dbus/dbus.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <thread>
+#include <vector>
+
+// registers a bunch of synthetic mpris players on the session bus and keeps changing their tracks. Every album name
+// carries the CLOCK_MONOTONIC time of the change, so whoever ends up showing the track can tell how long it took.
+
+namespace {
+    struct Options {
+        int players = 1;
+        int churnMs = 5000;  // 0 keeps the tracks as they are
+        int64_t lengthMs = 200000;
+        const char* status = "Playing";
+        int hung = 0;  // the first n players never answer a call
+        double rate = 1.0;
+    };
+
+    struct Player {
+        std::string busName;
+        int track = 0;
+        std::string title;
+        std::string album;
+        std::string trackId;
+        std::chrono::steady_clock::time_point trackStart;
+        bool hung = false;
+    };
+
+    Options options;
+    std::atomic<bool> running{true};
+
+    int64_t monotonicNs() {
+        timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+    }
+
+    void nextTrack(Player& player) {
+        player.track++;
+        player.title = "Track " + std::to_string(player.track);
+        player.album = "Album @" + std::to_string(monotonicNs());
+        player.trackId = "/org/mpris/MediaPlayer2/bench/track" + std::to_string(player.track);
+        player.trackStart = std::chrono::steady_clock::now();
+    }
+
+    void appendVariant(DBusMessageIter* iter, int type, const char* signature, const void* value) {
+        DBusMessageIter variant;
+        dbus_message_iter_open_container(iter, DBUS_TYPE_VARIANT, signature, &variant);
+        dbus_message_iter_append_basic(&variant, type, value);
+        dbus_message_iter_close_container(iter, &variant);
+    }
+
+    void appendEntry(DBusMessageIter* dict, const char* key, int type, const char* signature, const void* value) {
+        DBusMessageIter entry;
+        dbus_message_iter_open_container(dict, DBUS_TYPE_DICT_ENTRY, nullptr, &entry);
+        dbus_message_iter_append_basic(&entry, DBUS_TYPE_STRING, &key);
+        appendVariant(&entry, type, signature, value);
+        dbus_message_iter_close_container(dict, &entry);
+    }
+
+    void appendMetadata(DBusMessageIter* iter, const Player& player) {
+        DBusMessageIter variant, dict;
+        dbus_message_iter_open_container(iter, DBUS_TYPE_VARIANT, "a{sv}", &variant);
+        dbus_message_iter_open_container(&variant, DBUS_TYPE_ARRAY, "{sv}", &dict);
+
+        const char* title = player.title.c_str();
+        const char* album = player.album.c_str();
+        const char* trackId = player.trackId.c_str();
+        const char* url = "file:///bench/track.flac";
+        int64_t length = options.lengthMs * 1000;
+        appendEntry(&dict, "mpris:trackid", DBUS_TYPE_OBJECT_PATH, "o", &trackId);
+        appendEntry(&dict, "xesam:url", DBUS_TYPE_STRING, "s", &url);
+        appendEntry(&dict, "xesam:title", DBUS_TYPE_STRING, "s", &title);
+        appendEntry(&dict, "xesam:album", DBUS_TYPE_STRING, "s", &album);
+        appendEntry(&dict, "mpris:length", DBUS_TYPE_INT64, "x", &length);
+
+        DBusMessageIter entry, artistVariant, artists;
+        const char* key = "xesam:artist";
+        const char* artist = "Bench Artist";
+        const char* featured = "Bench Featured";
+        dbus_message_iter_open_container(&dict, DBUS_TYPE_DICT_ENTRY, nullptr, &entry);
+        dbus_message_iter_append_basic(&entry, DBUS_TYPE_STRING, &key);
+        dbus_message_iter_open_container(&entry, DBUS_TYPE_VARIANT, "as", &artistVariant);
+        dbus_message_iter_open_container(&artistVariant, DBUS_TYPE_ARRAY, "s", &artists);
+        dbus_message_iter_append_basic(&artists, DBUS_TYPE_STRING, &artist);
+        dbus_message_iter_append_basic(&artists, DBUS_TYPE_STRING, &featured);
+        dbus_message_iter_close_container(&artistVariant, &artists);
+        dbus_message_iter_close_container(&entry, &artistVariant);
+        dbus_message_iter_close_container(&dict, &entry);
+
+        dbus_message_iter_close_container(&variant, &dict);
+        dbus_message_iter_close_container(iter, &variant);
+    }
+
+    // appends the property as a variant, returns false for properties the mock doesn't know
+    bool appendProperty(DBusMessageIter* iter, const Player& player, const char* property) {
+        if (strcmp(property, "Metadata") == 0) {
+            appendMetadata(iter, player);
+        } else if (strcmp(property, "PlaybackStatus") == 0) {
+            appendVariant(iter, DBUS_TYPE_STRING, "s", &options.status);
+        } else if (strcmp(property, "Position") == 0) {
+            auto elapsed = std::chrono::steady_clock::now() - player.trackStart;
+            int64_t position = std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count() * options.rate;
+            appendVariant(iter, DBUS_TYPE_INT64, "x", &position);
+        } else if (strcmp(property, "Rate") == 0) {
+            appendVariant(iter, DBUS_TYPE_DOUBLE, "d", &options.rate);
+        } else {
+            return false;
+        }
+        return true;
+    }
+
+    DBusHandlerResult handleMessage(DBusConnection* conn, DBusMessage* message, void* data) {
+        Player& player = *static_cast<Player*>(data);
+        DBusMessage* reply = nullptr;
+        if (player.hung)
+            return DBUS_HANDLER_RESULT_HANDLED;  // like a player stuck in its main loop
+
+        if (dbus_message_is_method_call(message, DBUS_INTERFACE_PROPERTIES, "Get")) {
+            const char* interface = nullptr;
+            const char* property = nullptr;
+            dbus_message_get_args(message, nullptr, DBUS_TYPE_STRING, &interface, DBUS_TYPE_STRING, &property,
+                                  DBUS_TYPE_INVALID);
+            reply = dbus_message_new_method_return(message);
+            DBusMessageIter iter;
+            dbus_message_iter_init_append(reply, &iter);
+            if (!property || !appendProperty(&iter, player, property)) {
+                dbus_message_unref(reply);
+                reply = dbus_message_new_error(message, DBUS_ERROR_UNKNOWN_PROPERTY, "unknown property");
+            }
+        } else if (dbus_message_is_method_call(message, DBUS_INTERFACE_PROPERTIES, "GetAll")) {
+            reply = dbus_message_new_method_return(message);
+            DBusMessageIter iter, dict;
+            dbus_message_iter_init_append(reply, &iter);
+            dbus_message_iter_open_container(&iter, DBUS_TYPE_ARRAY, "{sv}", &dict);
+            for (const char* property : {"Metadata", "PlaybackStatus", "Position", "Rate"}) {
+                DBusMessageIter entry;
+                dbus_message_iter_open_container(&dict, DBUS_TYPE_DICT_ENTRY, nullptr, &entry);
+                dbus_message_iter_append_basic(&entry, DBUS_TYPE_STRING, &property);
+                appendProperty(&entry, player, property);
+                dbus_message_iter_close_container(&dict, &entry);
+            }
+            dbus_message_iter_close_container(&iter, &dict);
+        } else {
+            return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+        }
+
+        dbus_connection_send(conn, reply, nullptr);
+        dbus_message_unref(reply);
+        return DBUS_HANDLER_RESULT_HANDLED;
+    }
+
+    void announceMetadata(DBusConnection* conn, const Player& player) {
+        DBusMessage* signal =
+            dbus_message_new_signal("/org/mpris/MediaPlayer2", DBUS_INTERFACE_PROPERTIES, "PropertiesChanged");
+        DBusMessageIter iter, changed, entry, invalidated;
+        const char* interface = "org.mpris.MediaPlayer2.Player";
+        const char* property = "Metadata";
+        dbus_message_iter_init_append(signal, &iter);
+        dbus_message_iter_append_basic(&iter, DBUS_TYPE_STRING, &interface);
+        dbus_message_iter_open_container(&iter, DBUS_TYPE_ARRAY, "{sv}", &changed);
+        dbus_message_iter_open_container(&changed, DBUS_TYPE_DICT_ENTRY, nullptr, &entry);
+        dbus_message_iter_append_basic(&entry, DBUS_TYPE_STRING, &property);
+        appendMetadata(&entry, player);
+        dbus_message_iter_close_container(&changed, &entry);
+        dbus_message_iter_close_container(&iter, &changed);
+        dbus_message_iter_open_container(&iter, DBUS_TYPE_ARRAY, "s", &invalidated);
+        dbus_message_iter_close_container(&iter, &invalidated);
+        dbus_connection_send(conn, signal, nullptr);
+        dbus_message_unref(signal);
+        dbus_connection_flush(conn);
+    }
+
+    // every player gets its own connection, the backend tells players apart by their unique bus name
+    void runPlayer(int index) {
+        DBusError error;
+        dbus_error_init(&error);
+        DBusConnection* conn = dbus_bus_get_private(DBUS_BUS_SESSION, &error);
+        if (!conn) {
+            fprintf(stderr, "mock_player: can't connect to the session bus: %s\n", error.message);
+            dbus_error_free(&error);
+            running = false;
+            return;
+        }
+
+        Player player;
+        player.busName = "org.mpris.MediaPlayer2.bench" + std::to_string(index);
+        player.hung = index < options.hung;
+        nextTrack(player);
+
+        DBusObjectPathVTable vtable{};
+        vtable.message_function = handleMessage;
+        dbus_connection_register_object_path(conn, "/org/mpris/MediaPlayer2", &vtable, &player);
+        dbus_bus_request_name(conn, player.busName.c_str(), DBUS_NAME_FLAG_DO_NOT_QUEUE, &error);
+        if (dbus_error_is_set(&error)) {
+            fprintf(stderr, "mock_player: can't own %s: %s\n", player.busName.c_str(), error.message);
+            dbus_error_free(&error);
+        }
+
+        // spread the players over the churn period so they don't all change at the same time
+        auto nextChange = std::chrono::steady_clock::now() +
+                          std::chrono::milliseconds(options.churnMs + options.churnMs * index / options.players);
+        while (running && dbus_connection_read_write_dispatch(conn, 10)) {
+            if (options.churnMs > 0 && std::chrono::steady_clock::now() >= nextChange) {
+                nextChange += std::chrono::milliseconds(options.churnMs);
+                nextTrack(player);
+                announceMetadata(conn, player);
+            }
+        }
+        dbus_connection_close(conn);
+        dbus_connection_unref(conn);
+    }
+}  // namespace
+
+int main(int argc, char** argv) {
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--players") == 0 && i + 1 < argc)
+            options.players = std::max(1, atoi(argv[++i]));
+        else if (strcmp(argv[i], "--churn-ms") == 0 && i + 1 < argc)
+            options.churnMs = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--paused") == 0)
+            options.status = "Paused";
+        else if (strcmp(argv[i], "--hung") == 0 && i + 1 < argc)
+            options.hung = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--rate") == 0 && i + 1 < argc)
+            options.rate = atof(argv[++i]);
+        else {
+            fprintf(stderr, "usage: %s [--players n] [--churn-ms ms] [--paused] [--hung n] [--rate r]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < options.players; i++) threads.emplace_back(runPlayer, i);
+    for (auto& thread : threads) thread.join();
+    return 0;
+}
@@ -0,0 +1,41 @@
+#!/bin/sh
+# starts a private dbus-daemon with mock players on it and runs the benchmarks against it, so nothing on the real
+# session bus gets in the way.
+#   run.sh <bench dir> [--players n] [--churn-ms ms] [--seconds s]
+set -e
+
+BENCH_DIR="$1"
+shift
+PLAYERS=4
+CHURN_MS=5000
+SECONDS_TO_RUN=30
+while [ $# -gt 0 ]; do
+    case "$1" in
+        --players) PLAYERS="$2"; shift 2 ;;
+        --churn-ms) CHURN_MS="$2"; shift 2 ;;
+        --seconds) SECONDS_TO_RUN="$2"; shift 2 ;;
+        *) echo "unknown option $1" >&2; exit 1 ;;
+    esac
+done
+
+BUS_INFO=$(dbus-daemon --config-file="$(dirname "$0")/session.conf" --fork --print-address=1 --print-pid=1)
+DBUS_SESSION_BUS_ADDRESS=$(echo "$BUS_INFO" | sed -n 1p)
+BUS_PID=$(echo "$BUS_INFO" | sed -n 2p)
+export DBUS_SESSION_BUS_ADDRESS
+
+"$BENCH_DIR/mock_player" --players "$PLAYERS" --churn-ms "$CHURN_MS" &
+PLAYER_PID=$!
+trap 'kill $PLAYER_PID $BUS_PID 2>/dev/null' EXIT
+sleep 0.5
+
+echo "players $PLAYERS, churn ${CHURN_MS}ms"
+"$BENCH_DIR/bench_backend" --watch-seconds "$SECONDS_TO_RUN"
+"$BENCH_DIR/bench_poll" --seconds "$SECONDS_TO_RUN"
+"$BENCH_DIR/bench_pipeline" --seconds "$SECONDS_TO_RUN"
+"$BENCH_DIR/bench_rpc"
+"$BENCH_DIR/bench_settings"
+"$BENCH_DIR/bench_http"
+"$BENCH_DIR/bench_lastfm"
+"$BENCH_DIR/bench_scrobble"
+"$BENCH_DIR/bench_trackkey"
+"$BENCH_DIR/bench_snapshots"
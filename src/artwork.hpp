@@ -0,0 +1,235 @@
+#ifndef _ARTWORK_
+#define _ARTWORK_
+
+#include <atomic>
+#include <condition_variable>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+#include "atomicfile.hpp"
+#include "metrics.hpp"
+#include "utils.hpp"
+
+// lru cache of itunes results that survives restarts. Entries expire after a while, lookups that found nothing are
+// cached as well (with a shorter lifetime) so unknown songs don't hit the network on every replay either.
+class SongInfoCache {
+public:
+    SongInfoCache(std::filesystem::path file, size_t capacity = 1000, int64_t ttlSeconds = 30 * 24 * 60 * 60,
+                  int64_t negativeTtlSeconds = 24 * 60 * 60)
+        : file(std::move(file)), capacity(capacity), ttl(ttlSeconds), negativeTtl(negativeTtlSeconds) {
+        load();
+    }
+
+    // case, leading/trailing and repeated whitespace don't change what itunes returns, so they shouldn't change the key
+    static std::string normalize(const std::string& query) {
+        std::string key;
+        key.reserve(query.size());
+        for (unsigned char c : query) {
+            if (std::isspace(c)) {
+                if (!key.empty() && key.back() != ' ')
+                    key += ' ';
+            } else
+                key += static_cast<char>(std::tolower(c));
+        }
+        if (!key.empty() && key.back() == ' ')
+            key.pop_back();
+        return key;
+    }
+
+    bool get(const std::string& key, utils::SongInfo& info) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = index.find(key);
+        if (it == index.end())
+            return false;
+
+        if (isExpired(*it->second)) {
+            entries.erase(it->second);
+            index.erase(it);
+            return false;
+        }
+
+        entries.splice(entries.end(), entries, it->second);  // most recently used entries live at the back
+        info = it->second->info;
+        return true;
+    }
+
+    // an empty artworkURL is stored as a negative entry
+    void put(const std::string& key, const utils::SongInfo& info) {
+        std::lock_guard<std::mutex> lock(mutex);
+        insert(key, info, time(nullptr));
+        save();
+    }
+
+private:
+    struct Entry {
+        std::string key;
+        utils::SongInfo info;
+        int64_t storedAt;
+    };
+
+    bool isExpired(const Entry& entry) const {
+        int64_t lifetime = entry.info.artworkURL == "" ? negativeTtl : ttl;
+        return time(nullptr) - entry.storedAt > lifetime;
+    }
+
+    void insert(const std::string& key, const utils::SongInfo& info, int64_t storedAt) {
+        auto it = index.find(key);
+        if (it != index.end()) {
+            entries.erase(it->second);
+            index.erase(it);
+        }
+
+        entries.push_back({key, info, storedAt});
+        index[key] = std::prev(entries.end());
+
+        while (entries.size() > capacity) {
+            index.erase(entries.front().key);
+            entries.pop_front();
+        }
+    }
+
+    // one entry per line: stored at, track id, artwork url and the key, separated by tabs. The key is normalized, so
+    // it can't contain tabs or newlines itself.
+    void load() {
+        std::ifstream i(file);
+        std::string line;
+        while (std::getline(i, line)) {
+            size_t first = line.find('\t');
+            size_t second = line.find('\t', first + 1);
+            size_t third = line.find('\t', second + 1);
+            if (first == std::string::npos || second == std::string::npos || third == std::string::npos)
+                continue;
+
+            try {
+                Entry entry;
+                entry.storedAt = std::stoll(line.substr(0, first));
+                entry.info.trackId = std::stoll(line.substr(first + 1, second - first - 1));
+                entry.info.artworkURL = line.substr(second + 1, third - second - 1);
+                entry.key = line.substr(third + 1);
+                if (!isExpired(entry))
+                    insert(entry.key, entry.info, entry.storedAt);
+            } catch (...) {
+            }
+        }
+    }
+
+    void save() {
+        std::ostringstream o;
+        for (const auto& entry : entries)
+            o << entry.storedAt << '\t' << entry.info.trackId << '\t' << entry.info.artworkURL << '\t' << entry.key
+              << '\n';
+        atomicfile::replace(file, o.str());
+    }
+
+    std::filesystem::path file;
+    size_t capacity;
+    int64_t ttl;
+    int64_t negativeTtl;
+    std::mutex mutex;
+    std::list<Entry> entries;
+    std::unordered_map<std::string, std::list<Entry>::iterator> index;
+};
+
+// resolves artwork and track ids in the background so a slow itunes search never holds up a presence update. Only
+// the latest request matters: queuing a new one drops the pending one and aborts the one currently in flight.
+class ArtworkLookup {
+public:
+    using Callback = std::function<void(const utils::SongInfo&)>;
+
+    ArtworkLookup() : cache(backend::getConfigDirectory() / "artwork_cache.tsv"), worker(&ArtworkLookup::run, this) {}
+
+    ~ArtworkLookup() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+            generation++;
+        }
+        wakeup.notify_one();
+        worker.join();
+    }
+
+    ArtworkLookup(const ArtworkLookup&) = delete;
+    ArtworkLookup& operator=(const ArtworkLookup&) = delete;
+
+    // answers from the cache without touching the network, so repeated songs get their artwork instantly
+    bool getCached(const std::string& query, utils::SongInfo& info) {
+        return cache.get(SongInfoCache::normalize(query), info);
+    }
+
+    // onResolved runs on the worker thread and is skipped if another request or cancel() came in meanwhile
+    void request(std::string query, Callback onResolved) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            pendingQuery = std::move(query);
+            pendingCallback = std::move(onResolved);
+            hasPending = true;
+            generation++;
+        }
+        wakeup.notify_one();
+    }
+
+    void cancel() {
+        std::lock_guard<std::mutex> lock(mutex);
+        hasPending = false;
+        pendingCallback = nullptr;
+        generation++;
+    }
+
+private:
+    void run() {
+        while (true) {
+            std::string query;
+            Callback onResolved;
+            uint64_t requestGeneration;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wakeup.wait(lock, [this] { return hasPending || stopping; });
+                if (stopping)
+                    return;
+                query = std::move(pendingQuery);
+                onResolved = std::move(pendingCallback);
+                hasPending = false;
+                requestGeneration = generation;
+            }
+
+            std::string key = SongInfoCache::normalize(query);
+            utils::SongInfo info{};
+            {
+                metrics::ScopedTimer timer(metrics::ARTWORK);
+                if (!cache.get(key, info)) {
+                    auto isStale = [this, requestGeneration] { return generation != requestGeneration; };
+                    bool succeeded = false;
+                    info = utils::getSongInfo(query, isStale, &succeeded);
+                    if (!succeeded) {
+                        timer.fail();
+                        continue;  // network error or aborted, nothing worth caching or reporting
+                    }
+                    cache.put(key, info);
+                }
+            }
+
+            if (generation == requestGeneration && onResolved)
+                onResolved(info);
+        }
+    }
+
+    std::mutex mutex;
+    std::condition_variable wakeup;
+    std::string pendingQuery;
+    Callback pendingCallback;
+    bool hasPending = false;
+    bool stopping = false;
+    std::atomic<uint64_t> generation{0};
+    SongInfoCache cache;
+    std::thread worker;
+};
+
+#endif
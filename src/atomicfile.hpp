@@ -0,0 +1,211 @@
+#ifndef _ATOMICFILE_
+#define _ATOMICFILE_
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <thread>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// files that get replaced as a whole. Readers either see the old or the new contents, never a half written file, and
+// a crash in the middle leaves the old one in place.
+namespace atomicfile {
+    inline bool read(const std::filesystem::path& file, std::string& contents) {
+        std::ifstream in(file, std::ios::binary);
+        if (!in)
+            return false;
+        contents.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        return !in.bad();
+    }
+
+    inline bool syncAndClose(FILE* out) {
+        bool ok = std::fflush(out) == 0;
+#ifdef _WIN32
+        ok = ok && _commit(_fileno(out)) == 0;
+#else
+        ok = ok && fsync(fileno(out)) == 0;
+#endif
+        return std::fclose(out) == 0 && ok;
+    }
+
+    // writes into a temporary file next to the target, flushes it to the disk and renames it over the target. With
+    // backup set, the file being replaced is kept as <file>.bak through a hard link, so nothing gets copied.
+    inline bool replace(const std::filesystem::path& file, const std::string& contents, bool backup = false) {
+        std::filesystem::path temporary = file;
+        temporary += ".tmp";
+#ifdef _WIN32
+        FILE* out = _wfopen(temporary.c_str(), L"wb");
+#else
+        FILE* out = std::fopen(temporary.c_str(), "wb");
+#endif
+        if (!out)
+            return false;
+        bool written = std::fwrite(contents.data(), 1, contents.size(), out) == contents.size();
+        std::error_code error;
+        if (!syncAndClose(out) || !written) {
+            std::filesystem::remove(temporary, error);
+            return false;
+        }
+
+        if (backup && std::filesystem::exists(file, error)) {
+            std::filesystem::path backupFile = file;
+            backupFile += ".bak";
+            std::filesystem::path backupTemporary = backupFile;
+            backupTemporary += ".tmp";
+            std::filesystem::remove(backupTemporary, error);
+            std::filesystem::create_hard_link(file, backupTemporary, error);
+            if (!error)
+                std::filesystem::rename(backupTemporary, backupFile, error);
+        }
+
+        std::filesystem::rename(temporary, file, error);
+        if (error) {
+            std::filesystem::remove(temporary, error);
+            return false;
+        }
+#ifndef _WIN32
+        // the rename itself only survives a power loss once the directory is on the disk as well
+        int directory = open(file.parent_path().c_str(), O_RDONLY | O_CLOEXEC);
+        if (directory >= 0) {
+            fsync(directory);
+            close(directory);
+        }
+#endif
+        return true;
+    }
+}  // namespace atomicfile
+
+// collects changes to a file and writes only the latest contents once nothing changed for a moment. Typing into a
+// text field that saves on every keystroke then ends up as a single write. maxDelay bounds how long a steady stream
+// of changes can keep the file from being written.
+class DebouncedWriter {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    DebouncedWriter(std::filesystem::path file, std::chrono::milliseconds delay = std::chrono::milliseconds(500),
+                    std::chrono::milliseconds maxDelay = std::chrono::seconds(2))
+        : file(std::move(file)), delay(delay), maxDelay(maxDelay), worker(&DebouncedWriter::run, this) {}
+
+    ~DebouncedWriter() {
+        flush();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wakeup.notify_all();
+        worker.join();
+    }
+
+    DebouncedWriter(const DebouncedWriter&) = delete;
+    DebouncedWriter& operator=(const DebouncedWriter&) = delete;
+
+    // replaces whatever is waiting to be written
+    void schedule(std::string contents) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto now = Clock::now();
+            if (!pending)
+                firstChange = now;
+            pending = true;
+            pendingContents = std::move(contents);
+            lastChange = now;
+        }
+        wakeup.notify_all();
+    }
+
+    // writes pending changes right away and returns once they're on the disk
+    void flush() {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (!pending && !writing)
+            return;
+        flushRequested = true;
+        wakeup.notify_all();
+        written.wait(lock, [this] { return !pending && !writing; });
+    }
+
+    // true for contents this writer produced or is about to replace. The file watcher uses it to skip reloading the
+    // file after its own writes.
+    bool isOwnWrite(const std::string& contents) {
+        std::lock_guard<std::mutex> lock(mutex);
+        return pending || writing || (hasWritten && contents == lastWritten);
+    }
+
+    // a file that didn't parse is no good as a backup, this keeps the previous backup until the next write succeeded
+    void setBackup(bool enabled) {
+        std::lock_guard<std::mutex> lock(mutex);
+        backup = enabled;
+    }
+
+    uint64_t writeCount() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return writes;
+    }
+
+private:
+    void run() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            wakeup.wait(lock, [this] { return pending || stopping; });
+            if (!pending)
+                return;
+            auto due = std::min(lastChange + delay, firstChange + maxDelay);
+            if (!flushRequested && !stopping && Clock::now() < due) {
+                wakeup.wait_until(lock, due);
+                continue;  // more changes might have come in meanwhile
+            }
+
+            std::string contents = std::move(pendingContents);
+            bool keepBackup = backup;
+            pending = false;
+            flushRequested = false;
+            writing = true;
+            lock.unlock();
+            bool ok = atomicfile::replace(file, contents, keepBackup);
+            lock.lock();
+            writing = false;
+            writes++;
+            if (ok) {
+                lastWritten = std::move(contents);
+                hasWritten = true;
+                backup = true;
+            }
+            written.notify_all();
+        }
+    }
+
+    std::filesystem::path file;
+    std::chrono::milliseconds delay;
+    std::chrono::milliseconds maxDelay;
+
+    std::mutex mutex;
+    std::condition_variable wakeup;
+    std::condition_variable written;
+    bool pending = false;
+    bool writing = false;
+    bool flushRequested = false;
+    bool stopping = false;
+    bool backup = true;
+    std::string pendingContents;
+    Clock::time_point firstChange;
+    Clock::time_point lastChange;
+    std::string lastWritten;
+    bool hasWritten = false;
+    uint64_t writes = 0;
+    std::thread worker;
+};
+
+#endif
@@ -2,37 +2,75 @@
 #define _BACKEND_
 #include <stdint.h>
 
+#include <chrono>
 #include <memory>
 #include <string>
 #include <filesystem>
+#include <utility>
+#include <functional>
+#include <vector>
 
 struct MediaInfo {
-    bool paused;
+    bool paused = false;
     std::string songTitle;
-    std::string songArtist;
+    std::string songArtist;  // the first of songArtists, or the only one the platform knows about
+    std::vector<std::string> songArtists;
     std::string songAlbum;
     std::string songThumbnailData;
-    int64_t songDuration;
-    int64_t songElapsedTime;
+    std::string songArtUrl;  // mpris:artUrl on linux, file://, data: or a remote url
+    std::string songUrl;     // xesam:url, where the player got the track from
+    std::string trackId;     // mpris:trackid, unique per track in the player's queue. Empty if the player has none.
+    int64_t songDuration = 0;
+    int64_t songElapsedTime = 0;
+    double playbackRate = 1.0;  // how fast the position moves, 1.5 for a podcast at 1.5x
     std::string playbackSource;
     MediaInfo() {}
     MediaInfo(bool p, std::string title, std::string artist, std::string album, std::string source,
-              std::string thumbnail, int duration, int elapsed)
+              std::string thumbnail, int64_t duration, int64_t elapsed)
         : paused(p),
-          songTitle(title),
-          songArtist(artist),
-          songAlbum(album),
+          songTitle(std::move(title)),
+          songArtist(std::move(artist)),
+          songAlbum(std::move(album)),
+          songThumbnailData(std::move(thumbnail)),
           songDuration(duration),
           songElapsedTime(elapsed),
-          playbackSource(source),
-          songThumbnailData(thumbnail) {}
+          playbackSource(std::move(source)) {}
+
+    // empties everything but keeps the string buffers, so filling the same MediaInfo again doesn't allocate
+    void reset() {
+        paused = false;
+        songTitle.clear();
+        songArtist.clear();
+        songArtists.clear();
+        songAlbum.clear();
+        songThumbnailData.clear();
+        songArtUrl.clear();
+        songUrl.clear();
+        trackId.clear();
+        songDuration = 0;
+        songElapsedTime = 0;
+        playbackRate = 1.0;
+        playbackSource.clear();
+    }
 };
 
 namespace backend {
     bool init();
     bool toggleAutostart(bool enabled);
     std::filesystem::path getConfigDirectory();
-    std::shared_ptr<MediaInfo> getMediaInformation();
+    // calls onChange from a background thread whenever the given file in the config directory gets written
+    void watchConfigFile(const std::filesystem::path& file, std::function<void()> onChange);
+    // calls onAvailable from a background thread when discord's ipc socket shows up, so connecting doesn't have to
+    // be retried blindly. False if the backend can't watch for it, onAvailable is never called then.
+    bool watchDiscordSocket(std::function<void()> onAvailable);
+    // fills the caller's MediaInfo, returns false if nothing is playing. Passing the same MediaInfo on every call lets
+    // the backend reuse its buffers.
+    bool getMediaInformation(MediaInfo& mediaInfo);
+    // blocks until the backend noticed a change in the playback state or the timeout expired. Backends that can't be
+    // notified poll instead: they return true after at most a second, whatever the timeout.
+    bool waitForMediaChange(std::chrono::milliseconds timeout);
+    // process names in the order the user configured them, used to break ties if multiple players are active
+    void setPlayerPriority(const std::vector<std::string>& processNames);
 }  // namespace backend
 
 #endif
\ No newline at end of file
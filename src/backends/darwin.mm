@@ -4,9 +4,12 @@
 #include <Cocoa/Cocoa.h>
 #include <Foundation/Foundation.h>
 #include <dispatch/dispatch.h>
+#include <algorithm>
+#include <fcntl.h>
 #include <filesystem>
 #include <nlohmann-json/single_include/nlohmann/json.hpp>
 #include <fstream>
+#include <thread>
 
 #include "../MediaRemote.hpp"
 #include "../backend.hpp"
@@ -57,7 +60,7 @@ std::string executeCommand(const std::string &command, const std::vector<std::st
     return output;
 }
 
-std::shared_ptr<MediaInfo> backend::getMediaInformation() {
+bool backend::getMediaInformation(MediaInfo& mediaInfo) {
     // apple decided to prevent apps not signed by them to use media remote, so we use an apple script instead. But that
     // script only works on Sonoma or newer and the other one is arguably better, so keep the old method as well
     if (@available(macOS 15.0, *)) {
@@ -67,7 +70,7 @@ std::shared_ptr<MediaInfo> backend::getMediaInformation() {
 
         std::string appName = j["player"].get<std::string>();
         if (appName == "none")
-            return nullptr;
+            return false;
 
         bool paused = j["playbackStatus"].get<int>() == 0;
 
@@ -88,8 +91,9 @@ std::shared_ptr<MediaInfo> backend::getMediaInformation() {
         } catch (...) {
         }
 
-        return std::make_shared<MediaInfo>(paused, songTitle, songArtist, songAlbum, appName, "", durationMs,
-                                           elapsedTimeMs);
+        mediaInfo = MediaInfo(paused, std::move(songTitle), std::move(songArtist), std::move(songAlbum),
+                              std::move(appName), "", durationMs, elapsedTimeMs);
+        return true;
     } else {
         __block NSString *appName = nil;
         __block NSDictionary *playingInfo = nil;
@@ -116,7 +120,7 @@ std::shared_ptr<MediaInfo> backend::getMediaInformation() {
         dispatch_group_wait(group, DISPATCH_TIME_FOREVER);
         dispatch_release(group);
         if (appName == nil || playingInfo == nil)
-            return nullptr;
+            return false;
 
         bool paused = [playingInfo[(__bridge NSString *)kMRMediaRemoteNowPlayingInfoPlaybackRate] intValue] == 0;
 
@@ -147,8 +151,9 @@ std::shared_ptr<MediaInfo> backend::getMediaInformation() {
 
         [appName release];
         [playingInfo release];
-        return std::make_shared<MediaInfo>(paused, songTitle, songArtist, songAlbum, appNameString, thumbnailData,
-                                           durationMs, elapsedTimeMs);
+        mediaInfo = MediaInfo(paused, std::move(songTitle), std::move(songArtist), std::move(songAlbum),
+                              std::move(appNameString), std::move(thumbnailData), durationMs, elapsedTimeMs);
+        return true;
     }
 }
 
@@ -158,6 +163,63 @@ std::filesystem::path backend::getConfigDirectory() {
     return configDirectoryPath;
 }
 
+void backend::watchConfigFile(const std::filesystem::path& file, std::function<void()> onChange) {
+    dispatch_queue_t queue = dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_LOW, 0);
+    int fd = open(file.c_str(), O_EVTONLY);
+    if (fd < 0) {
+        // the file might be in the middle of getting replaced, try again later
+        dispatch_after(dispatch_time(DISPATCH_TIME_NOW, NSEC_PER_SEC), queue, ^{
+          watchConfigFile(file, onChange);
+        });
+        return;
+    }
+
+    dispatch_source_t source =
+        dispatch_source_create(DISPATCH_SOURCE_TYPE_VNODE, fd,
+                               DISPATCH_VNODE_WRITE | DISPATCH_VNODE_EXTEND | DISPATCH_VNODE_DELETE | DISPATCH_VNODE_RENAME,
+                               queue);
+    dispatch_source_set_event_handler(source, ^{
+      // a replaced file needs a new watch, the old descriptor still points at the old inode
+      if (dispatch_source_get_data(source) & (DISPATCH_VNODE_DELETE | DISPATCH_VNODE_RENAME)) {
+          dispatch_source_cancel(source);
+          dispatch_after(dispatch_time(DISPATCH_TIME_NOW, 100 * NSEC_PER_MSEC), queue, ^{
+            watchConfigFile(file, onChange);
+          });
+      }
+      onChange();
+    });
+    dispatch_source_set_cancel_handler(source, ^{
+      close(fd);
+      dispatch_release(source);
+    });
+    dispatch_resume(source);
+}
+
+bool backend::watchDiscordSocket(std::function<void()> onAvailable) {
+    // discord puts its socket into $TMPDIR. A vnode source on a directory fires for every entry created in it, that's
+    // more than needed but a spurious connection attempt is cheap.
+    const char* directory = std::getenv("TMPDIR");
+    int fd = open(directory ? directory : "/tmp", O_EVTONLY);
+    if (fd < 0)
+        return false;
+
+    dispatch_queue_t queue = dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_LOW, 0);
+    dispatch_source_t source = dispatch_source_create(DISPATCH_SOURCE_TYPE_VNODE, fd, DISPATCH_VNODE_WRITE, queue);
+    if (!source) {
+        close(fd);
+        return false;
+    }
+    dispatch_source_set_event_handler(source, ^{
+      onAvailable();
+    });
+    dispatch_source_set_cancel_handler(source, ^{
+      close(fd);
+      dispatch_release(source);
+    });
+    dispatch_resume(source);
+    return true;
+}
+
 bool backend::toggleAutostart(bool enabled) {
     std::filesystem::path launchAgentPath = std::getenv("HOME");
     launchAgentPath = launchAgentPath / "Library" / "LaunchAgents";
@@ -185,6 +247,14 @@ bool backend::toggleAutostart(bool enabled) {
     return true;
 }
 
+bool backend::waitForMediaChange(std::chrono::milliseconds timeout) {
+    // can't be notified about changes, so this polls once a second
+    std::this_thread::sleep_for(std::min<std::chrono::milliseconds>(timeout, std::chrono::seconds(1)));
+    return true;
+}
+
+void backend::setPlayerPriority(const std::vector<std::string>& processNames) {}
+
 bool backend::init() {
     hideDockIcon(true);
     return true;
@@ -1,15 +1,27 @@
 #if !defined(_WIN32) && !defined(__APPLE__)
 #include <dbus/dbus.h>
 
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
 #include <limits.h>
+#include <map>
+#include <strings.h>
+#include <sys/inotify.h>
+#include <thread>
 #include <unistd.h>
+#include <vector>
 
 #include "../backend.hpp"
+#include "../playbackclock.hpp"
 
 DBusConnection* conn = nullptr;
+// calls give up after this. A hung player gets skipped instead of stalling the media thread forever.
+constexpr int callTimeoutMs = 500;
 
 std::string getExecutablePath() {
     if (const char* appImagePath = std::getenv("APPIMAGE")) 
@@ -20,7 +32,7 @@ std::string getExecutablePath() {
     return (count != -1) ? std::string(result, count) : std::string();
 }
 
-std::string getActivePlayer(DBusConnection* conn) {
+std::vector<std::string> listPlayers(DBusConnection* conn) {
     DBusMessage* msg;
     DBusMessageIter args;
     DBusError err;
@@ -28,107 +40,341 @@ std::string getActivePlayer(DBusConnection* conn) {
 
     msg = dbus_message_new_method_call("org.freedesktop.DBus", "/org/freedesktop/DBus", "org.freedesktop.DBus",
                                        "ListNames");
-    DBusMessage* reply = dbus_connection_send_with_reply_and_block(conn, msg, -1, &err);
+    DBusMessage* reply = dbus_connection_send_with_reply_and_block(conn, msg, callTimeoutMs, &err);
     dbus_message_unref(msg);
 
     if (!reply) {
         dbus_error_free(&err);
-        return "";
+        return {};
     }
 
     dbus_message_iter_init(reply, &args);
     DBusMessageIter sub;
     dbus_message_iter_recurse(&args, &sub);
 
-    std::string active_player;
+    std::vector<std::string> players;
     while (dbus_message_iter_get_arg_type(&sub) == DBUS_TYPE_STRING) {
         const char* name;
         dbus_message_iter_get_basic(&sub, &name);
 
-        if (std::string(name).find("org.mpris.MediaPlayer2.") == 0) {
-            active_player = name;
-            break;
-        }
+        if (strncmp(name, "org.mpris.MediaPlayer2.", 23) == 0)
+            players.push_back(name);
 
         dbus_message_iter_next(&sub);
     }
 
     dbus_message_unref(reply);
-    return active_player;
+    return players;
 }
 
-bool isPlayerPaused(DBusConnection* conn, const std::string& player) {
-    DBusError err;
-    DBusMessage* msg;
-    DBusMessage* reply;
-    DBusMessageIter args;
-    const char* playbackStatus = nullptr;
-
-    dbus_error_init(&err);
-
-    msg = dbus_message_new_method_call(player.c_str(), "/org/mpris/MediaPlayer2", "org.freedesktop.DBus.Properties",
-                                       "Get");
+std::string getActivePlayer(DBusConnection* conn) {
+    auto players = listPlayers(conn);
+    return players.empty() ? "" : players.front();
+}
 
+// sends a Properties call to the player's Player interface without waiting for the answer, so calls to several players
+// can be in flight at the same time. Null if it couldn't be sent.
+DBusPendingCall* sendPropertiesCall(DBusConnection* conn, const std::string& player, const char* method,
+                                    const char* property = nullptr) {
+    DBusMessage* msg = dbus_message_new_method_call(player.c_str(), "/org/mpris/MediaPlayer2",
+                                                    "org.freedesktop.DBus.Properties", method);
     if (!msg)
-        return false;
+        return nullptr;
 
     const char* interface = "org.mpris.MediaPlayer2.Player";
-    const char* property = "PlaybackStatus";
-    dbus_message_append_args(msg, DBUS_TYPE_STRING, &interface, DBUS_TYPE_STRING, &property, DBUS_TYPE_INVALID);
-
-    reply = dbus_connection_send_with_reply_and_block(conn, msg, -1, &err);
+    if (property)
+        dbus_message_append_args(msg, DBUS_TYPE_STRING, &interface, DBUS_TYPE_STRING, &property, DBUS_TYPE_INVALID);
+    else
+        dbus_message_append_args(msg, DBUS_TYPE_STRING, &interface, DBUS_TYPE_INVALID);
+
+    DBusPendingCall* call = nullptr;
+    if (!dbus_connection_send_with_reply(conn, msg, &call, callTimeoutMs))
+        call = nullptr;
     dbus_message_unref(msg);
+    return call;
+}
 
-    if (!reply) {
-        if (dbus_error_is_set(&err))
-            dbus_error_free(&err);
+// null if the player answered with an error or not at all within callTimeoutMs of sending
+DBusMessage* waitForReply(DBusPendingCall* call) {
+    if (!call)
+        return nullptr;
+    dbus_pending_call_block(call);
+    DBusMessage* reply = dbus_pending_call_steal_reply(call);
+    dbus_pending_call_unref(call);
+    if (reply && dbus_message_get_type(reply) == DBUS_MESSAGE_TYPE_ERROR) {
+        dbus_message_unref(reply);
+        return nullptr;
+    }
+    return reply;
+}
 
-        return false;
+// decoders for the metadata entries we keep. Keys are compared in place and values get assigned into the strings that
+// are already there, so once the buffers are large enough decoding a track's metadata doesn't allocate.
+namespace {
+    // players use strings, mpris:trackid is an object path
+    void readString(DBusMessageIter* value, std::string& out) {
+        int type = dbus_message_iter_get_arg_type(value);
+        if (type != DBUS_TYPE_STRING && type != DBUS_TYPE_OBJECT_PATH)
+            return;
+        const char* str;
+        dbus_message_iter_get_basic(value, &str);
+        out.assign(str);
+    }
+
+    void decodeTitle(DBusMessageIter* value, MediaInfo& mediaInfo) { readString(value, mediaInfo.songTitle); }
+    void decodeAlbum(DBusMessageIter* value, MediaInfo& mediaInfo) { readString(value, mediaInfo.songAlbum); }
+    void decodeArtUrl(DBusMessageIter* value, MediaInfo& mediaInfo) { readString(value, mediaInfo.songArtUrl); }
+    void decodeUrl(DBusMessageIter* value, MediaInfo& mediaInfo) { readString(value, mediaInfo.songUrl); }
+
+    void decodeTrackId(DBusMessageIter* value, MediaInfo& mediaInfo) {
+        readString(value, mediaInfo.trackId);
+        if (mediaInfo.trackId == "/org/mpris/MediaPlayer2/TrackList/NoTrack")
+            mediaInfo.trackId.clear();
     }
 
-    if (dbus_message_iter_init(reply, &args) && DBUS_TYPE_VARIANT == dbus_message_iter_get_arg_type(&args)) {
-        DBusMessageIter variant;
-        dbus_message_iter_recurse(&args, &variant);
-        dbus_message_iter_get_basic(&variant, &playbackStatus);
+    // the spec says array of strings, a few players send a plain string anyway
+    void decodeArtists(DBusMessageIter* value, MediaInfo& mediaInfo) {
+        size_t count = 0;
+        auto add = [&mediaInfo, &count](DBusMessageIter* iter) {
+            const char* artist;
+            dbus_message_iter_get_basic(iter, &artist);
+            if (count < mediaInfo.songArtists.size())
+                mediaInfo.songArtists[count].assign(artist);
+            else
+                mediaInfo.songArtists.emplace_back(artist);
+            count++;
+        };
+
+        if (dbus_message_iter_get_arg_type(value) == DBUS_TYPE_STRING) {
+            add(value);
+        } else if (dbus_message_iter_get_arg_type(value) == DBUS_TYPE_ARRAY) {
+            DBusMessageIter artist_array;
+            dbus_message_iter_recurse(value, &artist_array);
+            while (dbus_message_iter_get_arg_type(&artist_array) == DBUS_TYPE_STRING) {
+                add(&artist_array);
+                dbus_message_iter_next(&artist_array);
+            }
+        }
+        mediaInfo.songArtists.resize(count);
+        if (count)
+            mediaInfo.songArtist.assign(mediaInfo.songArtists.front());
+        else
+            mediaInfo.songArtist.clear();
     }
 
-    bool isPaused = (playbackStatus && std::string(playbackStatus) == "Paused");
+    void decodeLength(DBusMessageIter* value, MediaInfo& mediaInfo) {
+        int type = dbus_message_iter_get_arg_type(value);
+        if (type != DBUS_TYPE_INT64 && type != DBUS_TYPE_UINT64)
+            return;
+        int64_t length;
+        dbus_message_iter_get_basic(value, &length);
+        mediaInfo.songDuration = length / 1000;
+    }
 
-    dbus_message_unref(reply);
-    return isPaused;
+    struct MetadataField {
+        const char* key;
+        void (*decode)(DBusMessageIter* value, MediaInfo& mediaInfo);
+    };
+
+    const MetadataField metadataFields[] = {
+        {"xesam:title", decodeTitle},   {"xesam:artist", decodeArtists}, {"xesam:album", decodeAlbum},
+        {"mpris:length", decodeLength}, {"mpris:artUrl", decodeArtUrl},  {"mpris:trackid", decodeTrackId},
+        {"xesam:url", decodeUrl},
+    };
+}  // namespace
+
+void processMetadata(DBusMessageIter* array_iter, MediaInfo& mediaInfo) {
+    while (dbus_message_iter_get_arg_type(array_iter) == DBUS_TYPE_DICT_ENTRY) {
+        DBusMessageIter dict_entry;
+        dbus_message_iter_recurse(array_iter, &dict_entry);
+
+        const char* key;
+        dbus_message_iter_get_basic(&dict_entry, &key);
+        dbus_message_iter_next(&dict_entry);
+
+        DBusMessageIter value_variant;
+        dbus_message_iter_recurse(&dict_entry, &value_variant);
+
+        for (const auto& field : metadataFields) {
+            if (strcmp(key, field.key) == 0) {
+                field.decode(&value_variant, mediaInfo);
+                break;
+            }
+        }
+        dbus_message_iter_next(array_iter);
+    }
+}
+
+bool readPosition(DBusMessageIter* variant, int64_t& positionMs) {
+    int type = dbus_message_iter_get_arg_type(variant);
+    if (type != DBUS_TYPE_INT64 && type != DBUS_TYPE_UINT64)
+        return false;
+    int64_t position;
+    dbus_message_iter_get_basic(variant, &position);
+    positionMs = position / 1000;
+    return true;
 }
 
-void getNowPlaying(DBusConnection* conn, const std::string& player, MediaInfo& mediaInfo) {
+// the answer to a Get of Position
+bool processPosition(DBusMessage* reply, int64_t& positionMs) {
+    DBusMessageIter args, variant;
+    if (!dbus_message_iter_init(reply, &args) || dbus_message_iter_get_arg_type(&args) != DBUS_TYPE_VARIANT)
+        return false;
+    dbus_message_iter_recurse(&args, &variant);
+    return readPosition(&variant, positionMs);
+}
+
+// the answer to GetAll, everything we need from a player in one round trip instead of one per property
+void processProperties(DBusMessage* reply, MediaInfo& mediaInfo, std::string& status) {
+    DBusMessageIter args, properties;
+    if (!dbus_message_iter_init(reply, &args) || dbus_message_iter_get_arg_type(&args) != DBUS_TYPE_ARRAY)
+        return;
+
+    dbus_message_iter_recurse(&args, &properties);
+    while (dbus_message_iter_get_arg_type(&properties) == DBUS_TYPE_DICT_ENTRY) {
+        DBusMessageIter dict_entry, value_variant;
+        dbus_message_iter_recurse(&properties, &dict_entry);
+        const char* key;
+        dbus_message_iter_get_basic(&dict_entry, &key);
+        dbus_message_iter_next(&dict_entry);
+        dbus_message_iter_recurse(&dict_entry, &value_variant);
+        int type = dbus_message_iter_get_arg_type(&value_variant);
+
+        if (strcmp(key, "Metadata") == 0 && type == DBUS_TYPE_ARRAY) {
+            DBusMessageIter array_iter;
+            dbus_message_iter_recurse(&value_variant, &array_iter);
+            processMetadata(&array_iter, mediaInfo);
+        } else if (strcmp(key, "PlaybackStatus") == 0 && type == DBUS_TYPE_STRING) {
+            const char* playbackStatus;
+            dbus_message_iter_get_basic(&value_variant, &playbackStatus);
+            status = playbackStatus;
+        } else if (strcmp(key, "Position") == 0) {
+            readPosition(&value_variant, mediaInfo.songElapsedTime);
+        } else if (strcmp(key, "Rate") == 0 && type == DBUS_TYPE_DOUBLE) {
+            double rate;
+            dbus_message_iter_get_basic(&value_variant, &rate);
+            if (rate > 0)
+                mediaInfo.playbackRate = rate;
+        }
+        dbus_message_iter_next(&properties);
+    }
+}
+
+std::string getNameOwner(DBusConnection* conn, const std::string& name) {
     DBusError err;
     dbus_error_init(&err);
 
-    auto sendDBusMessage = [&](const char* property) -> DBusMessage* {
-        DBusMessage* msg = dbus_message_new_method_call(player.c_str(), "/org/mpris/MediaPlayer2",
-                                                        "org.freedesktop.DBus.Properties", "Get");
-        const char* iface = "org.mpris.MediaPlayer2.Player";
-        dbus_message_append_args(msg, DBUS_TYPE_STRING, &iface, DBUS_TYPE_STRING, &property, DBUS_TYPE_INVALID);
-        DBusMessage* reply = dbus_connection_send_with_reply_and_block(conn, msg, -1, &err);
-        dbus_message_unref(msg);
-        return reply;
+    DBusMessage* msg = dbus_message_new_method_call("org.freedesktop.DBus", "/org/freedesktop/DBus",
+                                                    "org.freedesktop.DBus", "GetNameOwner");
+    const char* nameStr = name.c_str();
+    dbus_message_append_args(msg, DBUS_TYPE_STRING, &nameStr, DBUS_TYPE_INVALID);
+    DBusMessage* reply = dbus_connection_send_with_reply_and_block(conn, msg, callTimeoutMs, &err);
+    dbus_message_unref(msg);
+
+    if (!reply) {
+        dbus_error_free(&err);
+        return "";
+    }
+
+    const char* owner = nullptr;
+    std::string ret;
+    if (dbus_message_get_args(reply, &err, DBUS_TYPE_STRING, &owner, DBUS_TYPE_INVALID) && owner)
+        ret = owner;
+    else
+        dbus_error_free(&err);
+
+    dbus_message_unref(reply);
+    return ret;
+}
+
+// signal mode: instead of asking the player for everything once a second we subscribe to the mpris signals and keep
+// the last known state of every player around. Position is not announced by PropertiesChanged, so every player gets a
+// PlaybackClock that is anchored on track changes, Seeked, play/pause and rate changes and runs on its own in between.
+namespace {
+    struct PlayerState {
+        std::string busName;
+        std::string owner;  // signals are sent from the unique name, not the well known one
+        MediaInfo info;
+        bool playing = false;
+        bool metadataDirty = true;
+        bool positionDirty = false;
+        PlaybackClock clock;
+        std::chrono::steady_clock::time_point lastChange;
+        std::chrono::steady_clock::time_point retryAt;  // set when the player didn't answer
     };
 
-    auto processMetadata = [&](DBusMessage* reply) {
-        if (!reply) return;
-        
+    bool signalMode = false;
+    bool mediaChanged = true;
+    bool playerListDirty = true;
+
+    std::map<std::string, PlayerState> players;
+    std::string previousTrackId;  // scratch buffer for handlePropertiesChanged
+    std::vector<std::string> playerPriority;
+    std::string activePlayer;
+
+    void markChanged(PlayerState& player) {
+        player.lastChange = std::chrono::steady_clock::now();
+        mediaChanged = true;
+    }
+
+    size_t getPriority(const std::string& busName) {
+        for (size_t i = 0; i < playerPriority.size(); i++) {
+            if (strcasecmp(playerPriority[i].c_str(), busName.c_str()) == 0)
+                return i;
+        }
+        return playerPriority.size();
+    }
+
+    // playing beats paused, then whoever changed last, then the order of the process names in the settings
+    bool isPreferred(const PlayerState& a, const PlayerState& b) {
+        if (a.playing != b.playing)
+            return a.playing;
+        if (a.lastChange != b.lastChange)
+            return a.lastChange > b.lastChange;
+        return getPriority(a.busName) < getPriority(b.busName);
+    }
+
+    void selectActivePlayer() {
+        const PlayerState* best = nullptr;
+        for (const auto& [name, player] : players) {
+            if (!best || isPreferred(player, *best))
+                best = &player;
+        }
+
+        static const std::string none;
+        const std::string& selected = best ? best->busName : none;
+        if (selected != activePlayer) {
+            activePlayer = selected;
+            mediaChanged = true;
+        }
+    }
+
+    void addPlayer(const std::string& busName, const std::string& owner) {
+        PlayerState& player = players[busName];
+        player.busName = busName;
+        player.owner = owner;
+        player.metadataDirty = true;
+    }
+
+    void handlePropertiesChanged(PlayerState& player, DBusMessage* msg) {
         DBusMessageIter args;
-        dbus_message_iter_init(reply, &args);
-        if (dbus_message_iter_get_arg_type(&args) != DBUS_TYPE_VARIANT) return;
+        if (!dbus_message_iter_init(msg, &args) || dbus_message_iter_get_arg_type(&args) != DBUS_TYPE_STRING)
+            return;
+
+        const char* interface;
+        dbus_message_iter_get_basic(&args, &interface);
+        if (strcmp(interface, "org.mpris.MediaPlayer2.Player") != 0)
+            return;
 
-        DBusMessageIter variant;
-        dbus_message_iter_recurse(&args, &variant);
-        if (dbus_message_iter_get_arg_type(&variant) != DBUS_TYPE_ARRAY) return;
+        dbus_message_iter_next(&args);
+        if (dbus_message_iter_get_arg_type(&args) != DBUS_TYPE_ARRAY)
+            return;
 
-        DBusMessageIter array_iter;
-        dbus_message_iter_recurse(&variant, &array_iter);
-        
-        while (dbus_message_iter_get_arg_type(&array_iter) == DBUS_TYPE_DICT_ENTRY) {
+        DBusMessageIter changed;
+        dbus_message_iter_recurse(&args, &changed);
+        while (dbus_message_iter_get_arg_type(&changed) == DBUS_TYPE_DICT_ENTRY) {
             DBusMessageIter dict_entry;
-            dbus_message_iter_recurse(&array_iter, &dict_entry);
+            dbus_message_iter_recurse(&changed, &dict_entry);
 
             const char* key;
             dbus_message_iter_get_basic(&dict_entry, &key);
@@ -136,55 +382,203 @@ void getNowPlaying(DBusConnection* conn, const std::string& player, MediaInfo& m
 
             DBusMessageIter value_variant;
             dbus_message_iter_recurse(&dict_entry, &value_variant);
+            int type = dbus_message_iter_get_arg_type(&value_variant);
+
+            if (strcmp(key, "Metadata") == 0 && type == DBUS_TYPE_ARRAY) {
+                DBusMessageIter array_iter;
+                dbus_message_iter_recurse(&value_variant, &array_iter);
+                previousTrackId.swap(player.info.trackId);
+                player.info.songTitle.clear();
+                player.info.songArtist.clear();
+                player.info.songArtists.clear();
+                player.info.songAlbum.clear();
+                player.info.songArtUrl.clear();
+                player.info.songUrl.clear();
+                player.info.trackId.clear();
+                player.info.songDuration = 0;
+                processMetadata(&array_iter, player.info);
+                // the track id says for sure whether this is another track or just more metadata for the current one,
+                // like the cover arriving late. A new track usually starts at 0, but players are free to not tell us,
+                // so ask once.
+                player.clock.setDuration(player.info.songDuration);
+                if (player.info.trackId.empty() || player.info.trackId != previousTrackId) {
+                    player.clock.seek(0);
+                    player.positionDirty = true;
+                }
+                markChanged(player);
+            } else if (strcmp(key, "PlaybackStatus") == 0 && type == DBUS_TYPE_STRING) {
+                const char* status;
+                dbus_message_iter_get_basic(&value_variant, &status);
+                bool paused = strcmp(status, "Paused") == 0;
+                bool playing = strcmp(status, "Playing") == 0;
+                if (paused != player.info.paused || playing != player.playing) {
+                    // stopped counts as not moving either
+                    player.clock.setPaused(!playing);
+                    player.info.paused = paused;
+                    player.playing = playing;
+                    player.positionDirty = true;  // where it stopped exactly, or where it picked up again
+                    markChanged(player);
+                }
+            } else if (strcmp(key, "Rate") == 0 && type == DBUS_TYPE_DOUBLE) {
+                double rate;
+                dbus_message_iter_get_basic(&value_variant, &rate);
+                if (rate > 0 && rate != player.info.playbackRate) {
+                    player.clock.setRate(rate);
+                    player.info.playbackRate = rate;
+                    markChanged(player);
+                }
+            } else if (strcmp(key, "Position") == 0 && (type == DBUS_TYPE_INT64 || type == DBUS_TYPE_UINT64)) {
+                int64_t position;
+                dbus_message_iter_get_basic(&value_variant, &position);
+                player.clock.seek(position / 1000);
+                mediaChanged = true;
+            }
+            dbus_message_iter_next(&changed);
+        }
+
+        // invalidated properties have to be fetched again
+        dbus_message_iter_next(&args);
+        if (dbus_message_iter_get_arg_type(&args) == DBUS_TYPE_ARRAY) {
+            DBusMessageIter invalidated;
+            dbus_message_iter_recurse(&args, &invalidated);
+            if (dbus_message_iter_get_arg_type(&invalidated) == DBUS_TYPE_STRING)
+                player.metadataDirty = true;
+        }
+    }
+
+    DBusHandlerResult signalFilter(DBusConnection* connection, DBusMessage* msg, void* userData) {
+        if (dbus_message_get_type(msg) != DBUS_MESSAGE_TYPE_SIGNAL)
+            return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+
+        if (dbus_message_is_signal(msg, "org.freedesktop.DBus", "NameOwnerChanged")) {
+            const char* name = nullptr;
+            const char* oldOwner = nullptr;
+            const char* newOwner = nullptr;
+            if (dbus_message_get_args(msg, nullptr, DBUS_TYPE_STRING, &name, DBUS_TYPE_STRING, &oldOwner,
+                                      DBUS_TYPE_STRING, &newOwner, DBUS_TYPE_INVALID) &&
+                strncmp(name, "org.mpris.MediaPlayer2.", 23) == 0) {
+                // only touch the player that changed, everyone else keeps their state
+                if (*newOwner == '\0')
+                    players.erase(name);
+                else
+                    addPlayer(name, newOwner);
+                mediaChanged = true;
+            }
+            return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+        }
 
-            if (std::string(key) == "xesam:title" && dbus_message_iter_get_arg_type(&value_variant) == DBUS_TYPE_STRING) {
-                const char* title;
-                dbus_message_iter_get_basic(&value_variant, &title);
-                mediaInfo.songTitle = title;
-            } else if (std::string(key) == "xesam:album" && dbus_message_iter_get_arg_type(&value_variant) == DBUS_TYPE_STRING) {
-                const char* album;
-                dbus_message_iter_get_basic(&value_variant, &album);
-                mediaInfo.songAlbum = album;
-            } else if (std::string(key) == "xesam:artist" && dbus_message_iter_get_arg_type(&value_variant) == DBUS_TYPE_ARRAY) {
-                DBusMessageIter artist_array;
-                dbus_message_iter_recurse(&value_variant, &artist_array);
-                if (dbus_message_iter_get_arg_type(&artist_array) == DBUS_TYPE_STRING) {
-                    const char* artist;
-                    dbus_message_iter_get_basic(&artist_array, &artist);
-                    mediaInfo.songArtist = artist;
+        const char* sender = dbus_message_get_sender(msg);
+        if (!sender)
+            return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+
+        bool propertiesChanged = dbus_message_is_signal(msg, "org.freedesktop.DBus.Properties", "PropertiesChanged");
+        bool seeked = dbus_message_is_signal(msg, "org.mpris.MediaPlayer2.Player", "Seeked");
+        for (auto& [name, player] : players) {
+            if (player.owner != sender)
+                continue;
+
+            if (propertiesChanged) {
+                handlePropertiesChanged(player, msg);
+            } else if (seeked) {
+                int64_t position;
+                if (dbus_message_get_args(msg, nullptr, DBUS_TYPE_INT64, &position, DBUS_TYPE_INVALID)) {
+                    player.clock.seek(position / 1000);
+                    mediaChanged = true;
                 }
-            } else if (std::string(key) == "mpris:length" && 
-                      (dbus_message_iter_get_arg_type(&value_variant) == DBUS_TYPE_INT64 || dbus_message_iter_get_arg_type(&value_variant) == DBUS_TYPE_UINT64)) {
-                int64_t length;
-                dbus_message_iter_get_basic(&value_variant, &length);
-                mediaInfo.songDuration = length / 1000;
             }
-            dbus_message_iter_next(&array_iter);
         }
+        return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+    }
+
+    bool subscribeToSignals(DBusConnection* conn) {
+        const char* rules[] = {
+            "type='signal',sender='org.freedesktop.DBus',interface='org.freedesktop.DBus',member='NameOwnerChanged',"
+            "arg0namespace='org.mpris.MediaPlayer2'",
+            "type='signal',interface='org.freedesktop.DBus.Properties',member='PropertiesChanged',"
+            "path='/org/mpris/MediaPlayer2',arg0='org.mpris.MediaPlayer2.Player'",
+            "type='signal',interface='org.mpris.MediaPlayer2.Player',member='Seeked',path='/org/mpris/MediaPlayer2'",
+        };
+
+        DBusError err;
+        dbus_error_init(&err);
+        for (const char* rule : rules) {
+            dbus_bus_add_match(conn, rule, &err);
+            if (dbus_error_is_set(&err)) {
+                dbus_error_free(&err);
+                return false;
+            }
+        }
+        return dbus_connection_add_filter(conn, signalFilter, nullptr, nullptr);
+    }
+
+    void dispatchPendingSignals() {
+        dbus_connection_read_write(conn, 0);
+        while (dbus_connection_dispatch(conn) == DBUS_DISPATCH_DATA_REMAINS) {
+        }
+    }
+
+    struct Refresh {
+        PlayerState* player;
+        DBusPendingCall* call;
+        bool metadata;  // a GetAll, otherwise just the position
     };
+    std::vector<Refresh> refreshes;
+
+    // asks every player that needs it at once and then collects the answers, so the round trips overlap and a player
+    // that doesn't answer costs callTimeoutMs once per refresh, not once per property
+    void refreshPlayers() {
+        auto now = std::chrono::steady_clock::now();
+        refreshes.clear();
+        for (auto& [name, player] : players) {
+            if (now < player.retryAt)
+                continue;
+            if (player.metadataDirty)
+                refreshes.push_back({&player, sendPropertiesCall(conn, player.busName, "GetAll"), true});
+            else if (player.positionDirty)
+                refreshes.push_back({&player, sendPropertiesCall(conn, player.busName, "Get", "Position"), false});
+        }
 
-    DBusMessage* metadataReply = sendDBusMessage("Metadata");
-    processMetadata(metadataReply);
-    dbus_message_unref(metadataReply);
+        for (const auto& refresh : refreshes) {
+            PlayerState& player = *refresh.player;
+            DBusMessage* reply = waitForReply(refresh.call);
+            if (!reply) {
+                // leave it dirty and try again later, without holding up the other players every time
+                player.retryAt = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+                continue;
+            }
 
-    DBusMessage* positionReply = sendDBusMessage("Position");
-    if (positionReply) {
-        DBusMessageIter args;
-        dbus_message_iter_init(positionReply, &args);
-        if (dbus_message_iter_get_arg_type(&args) == DBUS_TYPE_VARIANT) {
-            DBusMessageIter variant;
-            dbus_message_iter_recurse(&args, &variant);
-            if (dbus_message_iter_get_arg_type(&variant) == DBUS_TYPE_INT64 || dbus_message_iter_get_arg_type(&variant) == DBUS_TYPE_UINT64) {
+            if (refresh.metadata) {
+                player.metadataDirty = false;
+                player.positionDirty = false;
+                player.info.reset();
+                std::string status;
+                processProperties(reply, player.info, status);
+                player.info.paused = status == "Paused";
+                player.info.playbackSource = player.busName;
+                player.playing = status == "Playing";
+                player.clock.start(player.info.songElapsedTime, !player.playing, player.info.playbackRate,
+                                   player.info.songDuration);
+            } else {
+                player.positionDirty = false;
                 int64_t position;
-                dbus_message_iter_get_basic(&variant, &position);
-                mediaInfo.songElapsedTime = position / 1000;
+                if (processPosition(reply, position))
+                    player.clock.seek(position);
             }
+            dbus_message_unref(reply);
         }
-        dbus_message_unref(positionReply);
     }
 
-    dbus_error_free(&err);
-}
+    void refreshCache() {
+        // the full list is only read once, afterwards NameOwnerChanged keeps it up to date
+        if (playerListDirty) {
+            playerListDirty = false;
+            for (const auto& name : listPlayers(conn)) addPlayer(name, getNameOwner(conn, name));
+        }
+
+        refreshPlayers();
+        selectActivePlayer();
+    }
+}  // namespace
 
 bool backend::init() {
     DBusError err;
@@ -204,18 +598,68 @@ bool backend::init() {
             return false;
         }
     }
+
+    // fall back to polling if the bus doesn't let us subscribe
+    signalMode = subscribeToSignals(conn);
     return true;
 }
 
-std::shared_ptr<MediaInfo> backend::getMediaInformation() {
-    MediaInfo ret;
+bool backend::getMediaInformation(MediaInfo& mediaInfo) {
+    if (!conn)
+        return false;
+
+    if (signalMode) {
+        dispatchPendingSignals();
+        refreshCache();
+        mediaChanged = false;
+        auto player = players.find(activePlayer);
+        if (player == players.end())
+            return false;
+        mediaInfo = player->second.info;  // copy assignment reuses the caller's buffers
+        mediaInfo.songElapsedTime = player->second.clock.position();
+        return true;
+    }
+
     std::string player = getActivePlayer(conn);
     if (player == "")
-        return nullptr;
-    getNowPlaying(conn, player, ret);
-    ret.paused = isPlayerPaused(conn, player);
-    ret.playbackSource = player;
-    return std::make_shared<MediaInfo>(ret);
+        return false;
+    DBusMessage* reply = waitForReply(sendPropertiesCall(conn, player, "GetAll"));
+    if (!reply)
+        return false;
+    mediaInfo.reset();
+    std::string status;
+    processProperties(reply, mediaInfo, status);
+    dbus_message_unref(reply);
+    mediaInfo.paused = status == "Paused";
+    mediaInfo.playbackSource = player;
+    return true;
+}
+
+void backend::setPlayerPriority(const std::vector<std::string>& processNames) {
+    if (processNames == playerPriority)
+        return;
+    playerPriority = processNames;
+    mediaChanged = true;
+}
+
+bool backend::waitForMediaChange(std::chrono::milliseconds timeout) {
+    if (!conn || !signalMode) {
+        std::this_thread::sleep_for(std::min<std::chrono::milliseconds>(timeout, std::chrono::seconds(1)));
+        return true;
+    }
+
+    auto deadline = std::chrono::steady_clock::now() + timeout;
+    dispatchPendingSignals();
+    while (!mediaChanged) {
+        auto remaining =
+            std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+        if (remaining <= 0)
+            break;
+        if (!dbus_connection_read_write_dispatch(conn, static_cast<int>(remaining)))
+            break;  // disconnected
+        dispatchPendingSignals();
+    }
+    return mediaChanged;
 }
 
 std::filesystem::path backend::getConfigDirectory() {
@@ -224,6 +668,85 @@ std::filesystem::path backend::getConfigDirectory() {
     return configDirectoryPath;
 }
 
+void backend::watchConfigFile(const std::filesystem::path& file, std::function<void()> onChange) {
+    int fd = inotify_init1(IN_CLOEXEC);
+    if (fd < 0)
+        return;
+
+    // watch the directory instead of the file itself, so replacing the file doesn't kill the watch
+    if (inotify_add_watch(fd, file.parent_path().c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_DELETE) < 0) {
+        close(fd);
+        return;
+    }
+
+    std::thread([fd, name = file.filename().string(), onChange]() {
+        alignas(inotify_event) char buffer[4096];
+        while (true) {
+            ssize_t length = read(fd, buffer, sizeof(buffer));
+            if (length < 0 && errno == EINTR)
+                continue;
+            if (length <= 0)
+                break;
+
+            bool changed = false;
+            for (char* ptr = buffer; ptr < buffer + length;) {
+                auto* event = reinterpret_cast<inotify_event*>(ptr);
+                if (event->len && name == event->name)
+                    changed = true;
+                ptr += sizeof(inotify_event) + event->len;
+            }
+
+            if (changed)
+                onChange();
+        }
+        close(fd);
+    }).detach();
+}
+
+bool backend::watchDiscordSocket(std::function<void()> onAvailable) {
+    // same lookup as discord-rpc: the first of these that is set, /tmp otherwise
+    const char* directory = nullptr;
+    for (const char* variable : {"XDG_RUNTIME_DIR", "TMPDIR", "TMP", "TEMP"}) {
+        directory = std::getenv(variable);
+        if (directory)
+            break;
+    }
+    if (!directory)
+        directory = "/tmp";
+
+    int fd = inotify_init1(IN_CLOEXEC);
+    if (fd < 0)
+        return false;
+    if (inotify_add_watch(fd, directory, IN_CREATE | IN_MOVED_TO) < 0) {
+        close(fd);
+        return false;
+    }
+
+    std::thread([fd, onAvailable]() {
+        alignas(inotify_event) char buffer[4096];
+        while (true) {
+            ssize_t length = read(fd, buffer, sizeof(buffer));
+            if (length < 0 && errno == EINTR)
+                continue;
+            if (length <= 0)
+                break;
+
+            bool appeared = false;
+            for (char* ptr = buffer; ptr < buffer + length;) {
+                auto* event = reinterpret_cast<inotify_event*>(ptr);
+                if (event->len && strncmp(event->name, "discord-ipc-", 12) == 0)
+                    appeared = true;
+                ptr += sizeof(inotify_event) + event->len;
+            }
+
+            if (appeared)
+                onAvailable();
+        }
+        close(fd);
+    }).detach();
+    return true;
+}
+
 bool backend::toggleAutostart(bool enabled) {
     const char* xdgHome = std::getenv("XDG_CONFIG_HOME");
 
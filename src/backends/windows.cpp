@@ -10,8 +10,10 @@
 #include <winrt/windows.media.control.h>
 #include <winrt/windows.storage.streams.h>
 
+#include <algorithm>
 #include <chrono>
 #include <filesystem>
+#include <thread>
 
 #include "../backend.hpp"
 #include "../utils.hpp"
@@ -69,6 +71,40 @@ std::filesystem::path backend::getConfigDirectory() {
     return configDirectoryPath;
 }
 
+void backend::watchConfigFile(const std::filesystem::path& file, std::function<void()> onChange) {
+    HANDLE directory = CreateFileW(file.parent_path().c_str(), FILE_LIST_DIRECTORY,
+                                   FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING,
+                                   FILE_FLAG_BACKUP_SEMANTICS, nullptr);
+    if (directory == INVALID_HANDLE_VALUE)
+        return;
+
+    std::thread([directory, name = file.filename().wstring(), onChange]() {
+        alignas(DWORD) char buffer[4096];
+        DWORD bytes = 0;
+        while (ReadDirectoryChangesW(directory, buffer, sizeof(buffer), FALSE,
+                                     FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME, &bytes, nullptr,
+                                     nullptr)) {
+            bool changed = bytes == 0;  // the buffer overflowed, so we don't know what changed
+            auto* info = reinterpret_cast<FILE_NOTIFY_INFORMATION*>(buffer);
+            while (bytes) {
+                if (_wcsnicmp(info->FileName, name.c_str(), info->FileNameLength / sizeof(WCHAR)) == 0 &&
+                    info->FileNameLength / sizeof(WCHAR) == name.size())
+                    changed = true;
+                if (!info->NextEntryOffset)
+                    break;
+                info = reinterpret_cast<FILE_NOTIFY_INFORMATION*>(reinterpret_cast<char*>(info) + info->NextEntryOffset);
+            }
+
+            if (changed)
+                onChange();
+        }
+        CloseHandle(directory);
+    }).detach();
+}
+
+// discord listens on a named pipe and named pipes can't be watched, the connection manager's backoff covers this
+bool backend::watchDiscordSocket(std::function<void()> onAvailable) { return false; }
+
 bool backend::toggleAutostart(bool enabled) {
     std::filesystem::path shortcutPath = std::getenv("APPDATA");
     shortcutPath = shortcutPath / "Microsoft" / "Windows" / "Start Menu" / "Programs" / "Startup";
@@ -85,18 +121,18 @@ bool backend::toggleAutostart(bool enabled) {
     return result;
 }
 
-std::shared_ptr<MediaInfo> backend::getMediaInformation() {
+bool backend::getMediaInformation(MediaInfo& mediaInfo) {
     static auto sessionManager = GlobalSystemMediaTransportControlsSessionManager::RequestAsync().get();
     auto currentSession = sessionManager.GetCurrentSession();
     if (!currentSession)
-        return nullptr;
+        return false;
 
     auto playbackInfo = currentSession.GetPlaybackInfo();
     try {
         auto mediaProperties = currentSession.TryGetMediaPropertiesAsync().get();
         auto timelineInformation = currentSession.GetTimelineProperties();
         if (!mediaProperties)
-            return nullptr;
+            return false;
 
         auto endTime = std::chrono::duration_cast<std::chrono::milliseconds>(timelineInformation.EndTime()).count();
         auto elapsedTime =
@@ -134,15 +170,24 @@ std::shared_ptr<MediaInfo> backend::getMediaInformation() {
 
         std::string modelId = toStdString(currentSession.SourceAppUserModelId());
 
-        return std::make_shared<MediaInfo>(
+        mediaInfo = MediaInfo(
             playbackInfo.PlaybackStatus() == GlobalSystemMediaTransportControlsSessionPlaybackStatus::Paused,
             toStdString(mediaProperties.Title()), std::move(artist), std::move(albumName), std::move(modelId),
             std::move(thumbnailData), endTime, elapsedTime);
+        return true;
     } catch (...) {
-        return nullptr;
+        return false;
     }
 }
 
+bool backend::waitForMediaChange(std::chrono::milliseconds timeout) {
+    // can't be notified about changes, so this polls once a second
+    std::this_thread::sleep_for(std::min<std::chrono::milliseconds>(timeout, std::chrono::seconds(1)));
+    return true;
+}
+
+void backend::setPlayerPriority(const std::vector<std::string>& processNames) {}
+
 bool backend::init() {
     return winrt::Windows::Foundation::Metadata::ApiInformation::IsTypePresent(
         L"Windows.Media.Control.GlobalSystemMediaTransportControlsSessionManager");
@@ -0,0 +1,132 @@
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <chrono>
+#include <thread>
+#else
+#include <csignal>
+#endif
+
+#include "../backend.hpp"
+#include "../medialog.hpp"
+#include "../pipeline.hpp"
+#include "../socketsource.hpp"
+#include "../utils.hpp"
+
+namespace {
+    struct SourceOptions {
+        std::string replay;
+        double speed = 1.0;
+        bool loop = false;
+        std::string listen;
+        std::string record;
+    };
+
+    const char* usage = " [--no-scrobble] [--replay <log> [--speed <factor>|max] [--loop]] [--listen <socket>]"
+                        " [--record <log>]";
+
+    // null if one of them couldn't be set up, the reason was printed already
+    std::shared_ptr<MediaSource> makeMediaSource(const SourceOptions& sourceOptions) {
+        std::vector<std::shared_ptr<MediaSource>> sources;
+        if (!sourceOptions.replay.empty()) {
+            auto replay = std::make_shared<ReplaySource>(sourceOptions.replay, sourceOptions.speed, sourceOptions.loop);
+            if (!replay->isLoaded()) {
+                std::cerr << "can't read media log " << sourceOptions.replay << "\n";
+                return nullptr;
+            }
+            sources.push_back(replay);
+        } else {
+            if (!backend::init()) {
+                std::cerr << "Error initializing platform backend!\n";
+                return nullptr;
+            }
+            sources.push_back(std::make_shared<BackendSource>());
+        }
+#ifndef _WIN32
+        if (!sourceOptions.listen.empty()) {
+            auto socketSource = std::make_shared<SocketSource>(sourceOptions.listen);
+            if (!socketSource->isListening()) {
+                std::cerr << "can't listen on " << sourceOptions.listen << "\n";
+                return nullptr;
+            }
+            sources.push_back(socketSource);
+        }
+#endif
+
+        std::shared_ptr<MediaSource> source =
+            sources.size() == 1 ? sources[0] : std::make_shared<MediaSources>(std::move(sources));
+        if (!sourceOptions.record.empty()) {
+            auto recorder = std::make_shared<RecordingSource>(source, sourceOptions.record);
+            if (!recorder->isRecording()) {
+                std::cerr << "can't write media log " << sourceOptions.record << "\n";
+                return nullptr;
+            }
+            source = recorder;
+        }
+        return source;
+    }
+}  // namespace
+
+// the same pipeline as the tray application, just without wxWidgets. Meant for servers and tiling window manager
+// setups where nobody looks at a tray icon anyway, settings are edited in the settings file and picked up live.
+int main(int argc, char** argv) {
+#ifndef _WIN32
+    // blocked before anything else runs, so every thread started later inherits the mask and only sigwait below sees
+    // them. Nothing starts a thread during static initialization, the pipeline creates its workers in start().
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+#endif
+
+    pipeline::Options options;
+    SourceOptions sourceOptions;
+    for (int i = 1; i < argc; i++) {
+        bool hasValue = i + 1 < argc;
+        if (std::strcmp(argv[i], "--no-scrobble") == 0) {
+            options.scrobbling = false;
+        } else if (std::strcmp(argv[i], "--replay") == 0 && hasValue) {
+            sourceOptions.replay = argv[++i];
+        } else if (std::strcmp(argv[i], "--speed") == 0 && hasValue) {
+            i++;
+            sourceOptions.speed = std::strcmp(argv[i], "max") == 0 ? 0 : std::atof(argv[i]);
+        } else if (std::strcmp(argv[i], "--loop") == 0) {
+            sourceOptions.loop = true;
+        } else if (std::strcmp(argv[i], "--listen") == 0 && hasValue) {
+            sourceOptions.listen = argv[++i];
+        } else if (std::strcmp(argv[i], "--record") == 0 && hasValue) {
+            sourceOptions.record = argv[++i];
+        } else if (std::strcmp(argv[i], "--help") == 0 || std::strcmp(argv[i], "-h") == 0) {
+            std::cout << "usage: " << argv[0] << usage << "\n";
+            return 0;
+        } else {
+            std::cerr << "unknown option " << argv[i] << "\n";
+            return 1;
+        }
+    }
+
+#ifdef _WIN32
+    options.mediaSource = makeMediaSource(sourceOptions);
+    if (!options.mediaSource)
+        return 1;
+    pipeline::start(options);
+    while (true) std::this_thread::sleep_for(std::chrono::hours(24));
+#else
+    options.mediaSource = makeMediaSource(sourceOptions);
+    if (!options.mediaSource)
+        return 1;
+    pipeline::start(options);
+    int signal = 0;
+    sigwait(&signals, &signal);
+    pipeline::stop();
+    utils::flushSettings();
+    // the watcher thread is still blocked in the backend, don't wait for it
+    std::_Exit(0);
+#endif
+}
@@ -0,0 +1,178 @@
+#ifndef _DISCORD_
+#define _DISCORD_
+
+#include <discord-rpc/discord_rpc.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <string>
+
+#include "presence.hpp"
+
+// owns the discord-rpc connection and everything sent through it. Connecting is retried with jittered exponential
+// backoff, and right away when the backend sees discord's ipc socket appear, instead of calling Discord_Initialize
+// every second while discord is closed. discord-rpc is a global singleton and not safe to initialize, shut down and
+// update from several threads, so all calls except socketAppeared() have to come from the same thread.
+class DiscordConnection {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    DiscordConnection(std::chrono::milliseconds minBackoff = std::chrono::seconds(1),
+                      std::chrono::milliseconds maxBackoff = std::chrono::seconds(60),
+                      std::chrono::milliseconds handshakeTimeout = std::chrono::seconds(5),
+                      std::chrono::milliseconds switchDelay = std::chrono::seconds(3))
+        : minBackoff(minBackoff),
+          maxBackoff(maxBackoff),
+          handshakeTimeout(handshakeTimeout),
+          switchDelay(switchDelay),
+          random(std::random_device()()) {}
+
+    ~DiscordConnection() { shutdown(); }
+
+    DiscordConnection(const DiscordConnection&) = delete;
+    DiscordConnection& operator=(const DiscordConnection&) = delete;
+
+    // switches to another application id right away. The current presence is handed to the new connection in the
+    // same go, so it's only gone for as long as the handshake takes.
+    void setClientId(const std::string& id, Clock::time_point now = Clock::now()) {
+        pendingClientId.clear();
+        if (id == clientId)
+            return;
+        clientId = id;
+        if (!initialized)
+            return;
+        shutdown();
+        initialize(now);  // no backoff, discord was reachable a moment ago
+    }
+
+    // asks for another application id, but only switches once it was asked for without interruption for
+    // switchDelay. A browser playing a notification sound in between two songs then doesn't cost two reconnects.
+    // nextPump() says when the switch is due.
+    void requestClientId(const std::string& id, Clock::time_point now = Clock::now()) {
+        if (id == clientId || !initialized) {
+            setClientId(id, now);  // nothing to tear down, or back to the current id before the switch happened
+            return;
+        }
+        if (id != pendingClientId) {
+            pendingClientId = id;
+            pendingSince = now;
+        }
+    }
+
+    // what discord should show. Kept around, so a new or restored connection gets it without anyone asking again.
+    void show(bool visible, const PresencePayload& payload) {
+        presenceVisible = visible;
+        presence = payload;
+        if (initialized)
+            PresenceManager::send(presenceVisible, presence);
+    }
+
+    // call regularly, runs the discord-rpc callbacks, (re)connects and switches ids when due. Returns true once per
+    // established connection.
+    bool pump(Clock::time_point now = Clock::now()) {
+        if (!pendingClientId.empty() && now >= pendingSince + switchDelay) {
+            std::string id = std::move(pendingClientId);
+            setClientId(id, now);
+        }
+
+        if (initialized && Discord_IsConnected()) {
+            bool established = !connected;
+            if (established) {
+                connected = true;
+                failures = 0;
+            }
+            Discord_RunCallbacks();
+            return established;
+        }
+
+        if (connected) {
+            // lost the connection, discord probably quit. Its socket showing up again is the quickest way back.
+            connected = false;
+            shutdown();
+            scheduleRetry(now);
+        }
+
+        bool socketSeen = socketChanged.exchange(false);
+        if (initialized) {
+            if (now < handshakeDeadline)
+                return false;
+            shutdown();  // nobody answered, stop discord-rpc from trying in the background
+            scheduleRetry(now);
+        }
+        if (clientId.empty() || (!socketSeen && now < nextAttempt))
+            return false;
+        initialize(now);
+        return false;
+    }
+
+    // when pump() has something to do next: look after a connection or a handshake in progress, carry out a pending
+    // id switch or, if nobody tells us about discord's socket, make the next attempt. Clock::time_point::max() if
+    // nothing is due until socketAppeared() or another call.
+    Clock::time_point nextPump(bool socketWatched, Clock::time_point now = Clock::now()) const {
+        Clock::time_point due = Clock::time_point::max();
+        if (initialized)
+            due = now + pumpInterval;
+        if (!pendingClientId.empty())
+            due = std::min(due, pendingSince + switchDelay);
+        if (!initialized && !socketWatched && !clientId.empty())
+            due = std::min(due, nextAttempt);
+        return due;
+    }
+
+    // thread safe, makes the next pump() try to connect regardless of the backoff
+    void socketAppeared() { socketChanged = true; }
+
+    void shutdown() {
+        if (!initialized)
+            return;
+        Discord_Shutdown();
+        initialized = false;
+        connected = false;
+    }
+
+    const std::string& getClientId() const { return clientId; }
+
+private:
+    void initialize(Clock::time_point now) {
+        DiscordEventHandlers handlers{};
+        Discord_Initialize(clientId.c_str(), &handlers);
+        initialized = true;
+        handshakeDeadline = now + handshakeTimeout;
+        // discord-rpc holds on to it until the handshake is done, no need to wait for the connection
+        if (presenceVisible)
+            PresenceManager::send(true, presence);
+    }
+
+    // the delay doubles with every failure, half of it is random so clients don't retry in lockstep
+    void scheduleRetry(Clock::time_point now) {
+        failures = std::min(failures + 1, 30);
+        auto delay = std::min<std::chrono::milliseconds>(maxBackoff, minBackoff * (1LL << std::min(failures - 1, 20)));
+        std::uniform_int_distribution<int64_t> jitter(0, delay.count() / 2);
+        nextAttempt = now + delay / 2 + std::chrono::milliseconds(jitter(random));
+    }
+
+    static constexpr std::chrono::seconds pumpInterval{1};
+
+    std::chrono::milliseconds minBackoff;
+    std::chrono::milliseconds maxBackoff;
+    std::chrono::milliseconds handshakeTimeout;
+    std::chrono::milliseconds switchDelay;
+    std::mt19937 random;
+
+    std::string clientId;
+    bool initialized = false;
+    bool connected = false;
+    int failures = 0;
+    Clock::time_point nextAttempt;
+    Clock::time_point handshakeDeadline;
+    std::atomic<bool> socketChanged{false};
+
+    std::string pendingClientId;
+    Clock::time_point pendingSince;
+    bool presenceVisible = false;
+    PresencePayload presence;
+};
+
+#endif
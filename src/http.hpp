@@ -0,0 +1,153 @@
+#ifndef _HTTP_
+#define _HTTP_
+#include <curl/include/curl/curl.h>
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <iterator>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// long lived http client. Easy handles are pooled and handed out per request, which makes it safe to use the client
+// from multiple threads at once. Every handle keeps its own connections, and a thread gets back the handle it used
+// last, so a worker talking to the same host again reuses its connection instead of doing a new tcp and tls handshake.
+// Only the dns and tls session caches are shared between handles, libcurl doesn't support sharing connections between
+// transfers that run at the same time.
+class HttpClient {
+public:
+    HttpClient(long connectTimeoutMs = 5000, long timeoutMs = 15000)
+        : connectTimeout(connectTimeoutMs), timeout(timeoutMs) {
+        share = curl_share_init();
+        curl_share_setopt(share, CURLSHOPT_LOCKFUNC, lockShare);
+        curl_share_setopt(share, CURLSHOPT_UNLOCKFUNC, unlockShare);
+        curl_share_setopt(share, CURLSHOPT_USERDATA, this);
+        curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+        curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+    }
+
+    ~HttpClient() {
+        for (auto& pooled : pool) curl_easy_cleanup(pooled.handle);
+        curl_share_cleanup(share);
+    }
+
+    HttpClient(const HttpClient&) = delete;
+    HttpClient& operator=(const HttpClient&) = delete;
+
+    // process wide client, curl_global_init is not thread safe so it has to happen exactly once before anything else.
+    // Never destroyed, a worker that is still in the middle of a request at exit keeps using it.
+    static HttpClient& get() {
+        [[maybe_unused]] static CURLcode initialized = curl_global_init(CURL_GLOBAL_ALL);
+        static HttpClient* client = new HttpClient();
+        return *client;
+    }
+
+    void setTimeouts(long connectTimeoutMs, long timeoutMs) {
+        connectTimeout = connectTimeoutMs;
+        timeout = timeoutMs;
+    }
+
+    // shouldAbort gets polled while the transfer is running and cancels it as soon as it returns true
+    std::string request(const std::string& url, const std::string& requestType = "GET",
+                        const std::string& postData = "", long* statusCode = nullptr,
+                        const std::function<bool()>& shouldAbort = nullptr) {
+        std::string buf;
+        CURL* curl = acquireHandle();
+        if (!curl)
+            return buf;
+
+        curl_easy_setopt(curl, CURLOPT_SHARE, share);
+        curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+        curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, requestType.c_str());
+        if (requestType != "GET" && requestType != "DELETE" && postData.length() > 0)
+            curl_easy_setopt(curl, CURLOPT_POSTFIELDS, postData.c_str());
+
+        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, writeCallback);
+        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &buf);
+        curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0L);
+        curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+        curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);
+        curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT_MS, connectTimeout.load());
+        curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS, timeout.load());
+        if (shouldAbort) {
+            curl_easy_setopt(curl, CURLOPT_XFERINFOFUNCTION, progressCallback);
+            curl_easy_setopt(curl, CURLOPT_XFERINFODATA, &shouldAbort);
+            curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 0L);
+        }
+
+        CURLcode res = curl_easy_perform(curl);
+        if (statusCode) {
+            *statusCode = 0;
+            if (res == CURLE_OK)
+                curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, statusCode);
+        }
+        if (res != CURLE_OK)
+            buf.clear();
+
+        releaseHandle(curl);
+        return buf;
+    }
+
+private:
+    static size_t writeCallback(char* contents, size_t size, size_t nmemb, void* userp) {
+        ((std::string*)userp)->append((char*)contents, size * nmemb);
+        return size * nmemb;
+    }
+
+    static int progressCallback(void* userp, curl_off_t, curl_off_t, curl_off_t, curl_off_t) {
+        return (*static_cast<const std::function<bool()>*>(userp))() ? 1 : 0;
+    }
+
+    static void lockShare(CURL*, curl_lock_data data, curl_lock_access, void* userp) {
+        static_cast<HttpClient*>(userp)->shareLocks[data].lock();
+    }
+
+    static void unlockShare(CURL*, curl_lock_data data, void* userp) {
+        static_cast<HttpClient*>(userp)->shareLocks[data].unlock();
+    }
+
+    // the handle this thread used last, its connections most likely go where this thread wants to go again
+    CURL* acquireHandle() {
+        {
+            std::lock_guard<std::mutex> lock(poolMutex);
+            if (!pool.empty()) {
+                auto pooled = std::find_if(pool.rbegin(), pool.rend(), [](const PooledHandle& pooled) {
+                    return pooled.owner == std::this_thread::get_id();
+                });
+                auto it = pooled != pool.rend() ? std::prev(pooled.base()) : std::prev(pool.end());
+                CURL* handle = it->handle;
+                pool.erase(it);
+                return handle;
+            }
+        }
+        return curl_easy_init();
+    }
+
+    void releaseHandle(CURL* handle) {
+        // reset drops the options of the last request but keeps the handle's own caches alive
+        curl_easy_reset(handle);
+        std::lock_guard<std::mutex> lock(poolMutex);
+        if (pool.size() < maxPooledHandles)
+            pool.push_back({handle, std::this_thread::get_id()});
+        else
+            curl_easy_cleanup(handle);
+    }
+
+    struct PooledHandle {
+        CURL* handle;
+        std::thread::id owner;
+    };
+
+    static constexpr size_t maxPooledHandles = 4;
+
+    CURLSH* share;
+    std::mutex shareLocks[CURL_LOCK_DATA_LAST];
+    std::mutex poolMutex;
+    std::vector<PooledHandle> pool;
+    std::atomic<long> connectTimeout;
+    std::atomic<long> timeout;
+};
+
+#endif
@@ -3,12 +3,22 @@
 
 #include <md5.hpp>
 #include <string>
+#include <vector>
 
 #include "utils.hpp"
 
+struct Scrobble {
+    std::string artist;
+    std::string track;
+    std::string album;
+    int64_t timestamp;  // unix time the track started playing
+    int64_t duration;   // seconds, 0 if unknown
+};
+
 class LastFM {
 public:
     enum LASTFM_STATUS {
+        NETWORK_ERROR = -1,
         SUCCESS = 0,
         AUTHENTICATION_FAILED = 4,
         INVALID_API_KEY = 10,
@@ -16,11 +26,16 @@ public:
         API_KEY_SUSPENDED = 26,
         UNKNOWN_ERROR = 16,
         INVALID_SESSION_KEY = 9,
+        SERVICE_OFFLINE = 11,
         SERVICE_TEMPORARILY_UNAVAILABLE = 13,
     };
 
-    LastFM(std::string u, std::string p, std::string ak, std::string as)
-        : username(u), password(p), api_key(ak), api_secret(as), authenticated(false) {}
+    // the maximum amount of scrobbles the api accepts in one track.scrobble call
+    static constexpr size_t MAX_SCROBBLE_BATCH = 50;
+
+    LastFM(std::string u, std::string p, std::string ak, std::string as,
+           std::string base = "https://ws.audioscrobbler.com/2.0/")
+        : username(u), password(p), api_key(ak), api_secret(as), authenticated(false), api_base(base) {}
 
     std::string getApiSignature(const std::map<std::string, std::string>& parameters) {
         std::string unhashedSignature = "";
@@ -57,32 +72,78 @@ public:
         }
     }
 
-    LASTFM_STATUS scrobble(std::string artist, std::string track) {
+    bool isAuthenticated() const { return authenticated; }
+
+    // submits up to MAX_SCROBBLE_BATCH scrobbles with a single request using the artist[i]/track[i]/timestamp[i] form
+    LASTFM_STATUS scrobble(const std::vector<Scrobble>& batch) {
         if (!authenticated)
             return LASTFM_STATUS::AUTHENTICATION_FAILED;
 
         std::map<std::string, std::string> parameters = {
-            {"api_key", api_key},  {"method", "track.scrobble"},
-            {"sk", session_token}, {"artist", artist},
-            {"track", track},      {"timestamp", std::to_string(time(NULL))},
-            {"format", "json"}};
+            {"api_key", api_key}, {"method", "track.scrobble"}, {"sk", session_token}, {"format", "json"}};
+
+        for (size_t i = 0; i < batch.size() && i < MAX_SCROBBLE_BATCH; i++) {
+            std::string index = "[" + std::to_string(i) + "]";
+            parameters["artist" + index] = batch[i].artist;
+            parameters["track" + index] = batch[i].track;
+            parameters["timestamp" + index] = std::to_string(batch[i].timestamp);
+            if (batch[i].album != "")
+                parameters["album" + index] = batch[i].album;
+            if (batch[i].duration > 0)
+                parameters["duration" + index] = std::to_string(batch[i].duration);
+        }
 
         parameters["api_sig"] = getApiSignature(parameters);
 
         std::string postBody = utils::getURLEncodedPostBody(parameters);
         std::string response = utils::httpRequest(api_base, "POST", postBody);
+        return getResponseStatus(response);
+    }
+
+    LASTFM_STATUS updateNowPlaying(const Scrobble& track) {
+        if (!authenticated)
+            return LASTFM_STATUS::AUTHENTICATION_FAILED;
+
+        std::map<std::string, std::string> parameters = {{"api_key", api_key},
+                                                         {"method", "track.updateNowPlaying"},
+                                                         {"sk", session_token},
+                                                         {"artist", track.artist},
+                                                         {"track", track.track},
+                                                         {"format", "json"}};
+        if (track.album != "")
+            parameters["album"] = track.album;
+        if (track.duration > 0)
+            parameters["duration"] = std::to_string(track.duration);
+
+        parameters["api_sig"] = getApiSignature(parameters);
 
-        return LASTFM_STATUS::SUCCESS;
+        std::string postBody = utils::getURLEncodedPostBody(parameters);
+        std::string response = utils::httpRequest(api_base, "POST", postBody);
+        return getResponseStatus(response);
     }
 
 private:
+    static LASTFM_STATUS getResponseStatus(const std::string& response) {
+        if (response == "")
+            return LASTFM_STATUS::NETWORK_ERROR;
+
+        try {
+            auto j = nlohmann::json::parse(response);
+            if (j.contains("error"))
+                return j["error"].get<LASTFM_STATUS>();
+            return LASTFM_STATUS::SUCCESS;
+        } catch (...) {
+            return LASTFM_STATUS::UNKNOWN_ERROR;
+        }
+    }
+
     bool authenticated;
     std::string session_token;
     std::string username;
     std::string password;
     std::string api_key;
     std::string api_secret;
-    const std::string api_base = "https://ws.audioscrobbler.com/2.0/";
+    const std::string api_base;
 };
 
 #endif
\ No newline at end of file
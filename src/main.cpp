@@ -1,4 +1,3 @@
-#include <discord-rpc/discord_rpc.h>
 #include <wx/image.h>
 #include <wx/mstream.h>
 #include <wx/statline.h>
@@ -6,161 +5,18 @@
 #include <wx/hyperlink.h>
 #include <wx/wx.h>
 
-#include <chrono>
 #include <cstddef>
-#include <thread>
+#include <cstdlib>
 
 #include "backend.hpp"
-#include "lastfm.hpp"
+#include "pipeline.hpp"
 #include "rsrc.hpp"
+#include "ui.hpp"
 #include "utils.hpp"
 #include "wx/sizer.h"
 
-std::string lastPlayingSong = "";
-std::string lastMediaSource = "";
-std::string currentSongTitle = "";
-utils::SongInfo songInfo;
-LastFM* lastfm = nullptr;
-
-void handleRPCTasks() {
-    while (true) {
-        while (!Discord_IsConnected()) {
-            DiscordEventHandlers handlers{};
-            auto app = utils::getApp(lastMediaSource);
-            Discord_Initialize(app.clientId.c_str(), &handlers);
-            std::this_thread::sleep_for(std::chrono::seconds(1));
-        }
-
-        while (Discord_IsConnected()) {
-            Discord_RunCallbacks();
-            std::this_thread::sleep_for(std::chrono::seconds(1));
-        }
-
-        Discord_Shutdown();
-    }
-}
-
-void initLastFM(bool checkMode = false) {
-    if (lastfm)
-        delete lastfm;
-    auto settings = utils::getSettings();
-    if (!settings.lastfm.enabled && !checkMode)
-        return;
-    lastfm = new LastFM(settings.lastfm.username, settings.lastfm.password, settings.lastfm.api_key,
-                        settings.lastfm.api_secret);
-    LastFM::LASTFM_STATUS status = lastfm->authenticate();
-    if (status) {
-        delete lastfm;
-        lastfm = nullptr;
-        if (checkMode)
-            wxMessageBox(_("Error authenticating at LastFM!"), _("PlayerLink"), wxOK | wxICON_ERROR);
-    } else if (checkMode)
-        wxMessageBox(_("The LastFM authentication was successful."), _("PlayerLink"), wxOK | wxICON_INFORMATION);
-}
-
-void handleMediaTasks() {
-    int64_t lastMs = 0;
-    while (true) {
-        std::this_thread::sleep_for(std::chrono::seconds(1));
-        if (!lastfm)
-            initLastFM();
-
-        auto mediaInformation = backend::getMediaInformation();
-        auto settings = utils::getSettings();
-        if (!mediaInformation) {
-            currentSongTitle = "";
-            Discord_ClearPresence();  // Nothing is playing rn, clear presence
-            continue;
-        }
-
-        if (mediaInformation->paused) {
-            lastMs = 0;
-            currentSongTitle = "";
-            Discord_ClearPresence();
-            continue;
-        }
-
-        std::string currentlyPlayingSong = mediaInformation->songTitle + mediaInformation->songArtist +
-                                           mediaInformation->songAlbum + std::to_string(mediaInformation->songDuration);
-        int64_t currentMs = mediaInformation->songElapsedTime;
-
-        bool shouldContinue =
-            currentlyPlayingSong == lastPlayingSong && (lastMs <= currentMs) && (lastMs + 3000 >= currentMs);
-        lastMs = currentMs;
-
-        if (shouldContinue)
-            continue;
-
-        std::string currentMediaSource = mediaInformation->playbackSource;
-
-        if (currentMediaSource != lastMediaSource) {
-            lastMediaSource = currentMediaSource;
-            Discord_Shutdown();
-        }  // reinitialize with new client id
-
-        auto app = utils::getApp(lastMediaSource);
-
-        if (lastPlayingSong.find(mediaInformation->songTitle + mediaInformation->songArtist +
-                                 mediaInformation->songAlbum) == std::string::npos &&
-            lastfm && app.enabled)
-            lastfm->scrobble(mediaInformation->songArtist, mediaInformation->songTitle);
-
-        lastPlayingSong = currentlyPlayingSong;
-        currentSongTitle = mediaInformation->songArtist + " - " + mediaInformation->songTitle;
-
-        if (!app.enabled) {
-            Discord_ClearPresence();
-            continue;
-        }
-        std::string serviceName = app.appName;
-
-        std::string activityState = mediaInformation->songArtist;
-        DiscordRichPresence activity{};
-        activity.type = app.type;
-        activity.displayType = app.displayType;
-        activity.details = mediaInformation->songTitle.c_str();
-        activity.state = activityState.c_str();
-        activity.smallImageText = serviceName.c_str();
-        songInfo = utils::getSongInfo(mediaInformation->songTitle + " " + mediaInformation->songArtist + " " +
-                                      mediaInformation->songAlbum);
-
-        activity.smallImageKey = "appicon";
-        if (songInfo.artworkURL == "") {
-            activity.smallImageKey = "";
-            activity.largeImageKey = "appicon";
-        } else {
-            activity.largeImageKey = songInfo.artworkURL.c_str();
-        }
-        activity.largeImageText = mediaInformation->songAlbum.c_str();
-
-        if (mediaInformation->songDuration != 0) {
-            int64_t remainingTime = mediaInformation->songDuration - mediaInformation->songElapsedTime;
-            activity.startTimestamp = time(nullptr) - (mediaInformation->songElapsedTime / 1000);
-            activity.endTimestamp = time(nullptr) + (remainingTime / 1000);
-        }
-        std::string endpointURL = app.searchEndpoint;
-
-        std::string searchQuery = mediaInformation->songTitle + " " + mediaInformation->songArtist;
-        std::string buttonName = "Search on " + serviceName;
-        std::string buttonText = endpointURL + utils::urlEncode(searchQuery);
-
-        if (endpointURL != "") {
-            activity.button1name = buttonName.c_str();
-            activity.button1link = buttonText.c_str();
-        }
-
-        std::string odesliUrl = utils::getOdesliURL(songInfo);
-        if (settings.odesli && songInfo.artworkURL != "") {
-            activity.button2name = "Show on Song.link";
-            activity.button2link = odesliUrl.c_str();
-        }
-
-        Discord_UpdatePresence(&activity);
-    }
-}
-
 void SetWindowIcon(wxTopLevelWindow* win) {
-    const wxIcon icon = utils::loadIconFromMemory(icon_png, icon_png_size);
+    const wxIcon icon = ui::loadIconFromMemory(icon_png, icon_png_size);
     win->SetIcon(icon);
 }
 
@@ -313,9 +169,10 @@ public:
             listBox->Append(process);
         }
 
-        if (app->processNames.size() == 0 && lastMediaSource != "") {
-            listBox->Append(lastMediaSource);
-            app->processNames.push_back(lastMediaSource);
+        std::string lastSource = pipeline::getNowPlaying()->source;
+        if (app->processNames.size() == 0 && lastSource != "") {
+            listBox->Append(lastSource);
+            app->processNames.push_back(lastSource);
         }
 
         processBox->Add(listBox, 1, wxALL | wxEXPAND, 5);
@@ -325,8 +182,8 @@ public:
         auto processNameInput =
             new wxTextCtrl(this, wxID_ANY, wxEmptyString, wxDefaultPosition, wxSize(250, wxDefaultSize.GetHeight()), 0);
         processNameInput->SetHint(_("Process name"));
-        const auto delete_button_texture = utils::loadSettingsIcon(trash_svg, trash_svg_size);
-        const auto add_button_texture = utils::loadSettingsIcon(plus_svg, plus_svg_size);
+        const auto delete_button_texture = ui::loadSettingsIcon(trash_svg, trash_svg_size);
+        const auto add_button_texture = ui::loadSettingsIcon(plus_svg, plus_svg_size);
         wxBitmapButton* addButton = new wxBitmapButton(this, wxID_ANY, add_button_texture);
         addButton->SetToolTip(_("Add process to list"));
         wxBitmapButton* removeButton = new wxBitmapButton(this, wxID_ANY, delete_button_texture);
@@ -383,12 +240,17 @@ public:
 
 protected:
     virtual wxMenu* CreatePopupMenu() override {
+        auto current = pipeline::getNowPlaying();
         wxMenu* menu = new wxMenu;
-        menu->Append(10004, currentSongTitle == "" ? _("Not Playing") : currentSongTitle);
+        wxMenuItem* nowPlayingItem =
+            new wxMenuItem(menu, 10004, current->title == "" ? _("Not Playing") : current->title);
+        if (current->thumbnail && current->title != "")
+            nowPlayingItem->SetBitmap(ui::thumbnailBitmap(*current->thumbnail));
+        menu->Append(nowPlayingItem);
         menu->Enable(10004, false);
         menu->AppendSeparator();
         menu->Append(10005, _("Copy Odesli URL"));
-        if (songInfo.artworkURL == "" || currentSongTitle == "")
+        if (current->songInfo.artworkURL == "" || current->title == "")
             menu->Enable(10005, false);
         menu->Append(10001, _("Settings"));
         menu->Append(10003, _("About PlayerLink"));
@@ -407,7 +269,9 @@ private:
         settingsFrame->Raise();
     }
 
-    void OnCopyOdesliURL(wxCommandEvent& evt) { utils::copyToClipboard(utils::getOdesliURL(songInfo)); }
+    void OnCopyOdesliURL(wxCommandEvent& evt) {
+        ui::copyToClipboard(utils::getOdesliURL(pipeline::getNowPlaying()->songInfo));
+    }
 
     void OnMenuExit(wxCommandEvent& evt) { settingsFrame->Close(true); }
 
@@ -452,9 +316,9 @@ public:
         enabledAppsText->Wrap(-1);
         enabledAppsContainer->Add(enabledAppsText, 0, wxALL, 5);
 
-        const auto edit_button_texture = utils::loadSettingsIcon(pencil_svg, pencil_svg_size);
-        const auto delete_button_texture = utils::loadSettingsIcon(trash_svg, trash_svg_size);
-        const auto add_button_texture = utils::loadSettingsIcon(plus_svg, plus_svg_size);
+        const auto edit_button_texture = ui::loadSettingsIcon(pencil_svg, pencil_svg_size);
+        const auto delete_button_texture = ui::loadSettingsIcon(trash_svg, trash_svg_size);
+        const auto add_button_texture = ui::loadSettingsIcon(plus_svg, plus_svg_size);
 
         wxBoxSizer* appCheckboxContainer = new wxBoxSizer(wxVERTICAL);
 
@@ -462,19 +326,17 @@ public:
         enabledAppsContainer->Add(vSizer, 0, wxEXPAND);
         auto settings = utils::getSettings();
 
-        for (const auto& app : settings.apps) {
+        for (const auto& app : settings->apps) {
             addCheckboxToContainer(panel, appCheckboxContainer, frameSizer, size, delete_button_texture,
                                    edit_button_texture, app);
         }
 
         wxBoxSizer* checkboxRowSizer = new wxBoxSizer(wxHORIZONTAL);
         auto anyOtherCheckbox = new wxCheckBox(panel, wxID_ANY, _("Any other"), wxDefaultPosition, wxDefaultSize, 0);
-        anyOtherCheckbox->SetValue(settings.anyOtherEnabled);
+        anyOtherCheckbox->SetValue(settings->anyOtherEnabled);
         anyOtherCheckbox->Bind(wxEVT_CHECKBOX, [](wxCommandEvent& event) {
             bool isChecked = event.IsChecked();
-            auto settings = utils::getSettings();
-            settings.anyOtherEnabled = isChecked;
-            utils::saveSettings(settings);
+            utils::updateSettings([isChecked](utils::Settings& settings) { settings.anyOtherEnabled = isChecked; });
         });
 
         wxBitmapButton* addButton = new wxBitmapButton(panel, wxID_ANY, add_button_texture);
@@ -484,9 +346,7 @@ public:
             utils::App* app = new utils::App();
             EditAppDialog dlg{this, _("Add new application"), app};
             if (dlg.ShowModal() == wxID_OK) {
-                auto settings = utils::getSettings();
-                settings.apps.push_back(*app);
-                utils::saveSettings(settings);
+                utils::updateSettings([app](utils::Settings& settings) { settings.apps.push_back(*app); });
                 addCheckboxToContainer(panel, appCheckboxContainer, frameSizer, size, delete_button_texture,
                                        edit_button_texture, *app);
                 this->SetSizerAndFit(frameSizer);
@@ -521,57 +381,53 @@ public:
         lastfmSettingsContainer = new wxBoxSizer(wxVERTICAL);
 
         auto lastfmEnabledCheckbox = new wxCheckBox(panel, wxID_ANY, _("Enabled"), wxDefaultPosition, wxDefaultSize, 0);
-        lastfmEnabledCheckbox->SetValue(settings.lastfm.enabled);
+        lastfmEnabledCheckbox->SetValue(settings->lastfm.enabled);
         lastfmEnabledCheckbox->Bind(wxEVT_CHECKBOX, [](wxCommandEvent& event) {
             bool isChecked = event.IsChecked();
-            auto settings = utils::getSettings();
-            settings.lastfm.enabled = isChecked;
-            utils::saveSettings(settings);
+            utils::updateSettings([isChecked](utils::Settings& settings) { settings.lastfm.enabled = isChecked; });
         });
         lastfmSettingsContainer->Add(lastfmEnabledCheckbox, 0, wxALIGN_CENTER | wxALL, 5);
         lastFMContainer->Add(lastfmSettingsContainer, 1, wxEXPAND, 5);
 
         auto usernameInput = new wxTextCtrl(panel, wxID_ANY, wxEmptyString, wxDefaultPosition, wxDefaultSize, 0);
         usernameInput->SetHint(_("Username"));
-        usernameInput->SetValue(settings.lastfm.username);
+        usernameInput->SetValue(settings->lastfm.username);
         usernameInput->Bind(wxEVT_TEXT, [this](wxCommandEvent& event) {
-            auto settings = utils::getSettings();
             std::string data = event.GetString().ToStdString();
-            settings.lastfm.username = data;
-            utils::saveSettings(settings);
+            utils::updateSettings([&data](utils::Settings& settings) { settings.lastfm.username = data; });
         });
         auto passwordInput =
             new wxTextCtrl(panel, wxID_ANY, wxEmptyString, wxDefaultPosition, wxDefaultSize, wxTE_PASSWORD);
         passwordInput->SetHint(_("Password"));
-        passwordInput->SetValue(settings.lastfm.password);
+        passwordInput->SetValue(settings->lastfm.password);
         passwordInput->Bind(wxEVT_TEXT, [this](wxCommandEvent& event) {
-            auto settings = utils::getSettings();
             std::string data = event.GetString().ToStdString();
-            settings.lastfm.password = data;
-            utils::saveSettings(settings);
+            utils::updateSettings([&data](utils::Settings& settings) { settings.lastfm.password = data; });
         });
         auto apikeyInput = new wxTextCtrl(panel, wxID_ANY, wxEmptyString, wxDefaultPosition, wxDefaultSize, 0);
         apikeyInput->SetHint(_("API-Key"));
-        apikeyInput->SetValue(settings.lastfm.api_key);
+        apikeyInput->SetValue(settings->lastfm.api_key);
         apikeyInput->Bind(wxEVT_TEXT, [this](wxCommandEvent& event) {
-            auto settings = utils::getSettings();
             std::string data = event.GetString().ToStdString();
-            settings.lastfm.api_key = data;
-            utils::saveSettings(settings);
+            utils::updateSettings([&data](utils::Settings& settings) { settings.lastfm.api_key = data; });
         });
         auto apisecretInput =
             new wxTextCtrl(panel, wxID_ANY, wxEmptyString, wxDefaultPosition, wxDefaultSize, wxTE_PASSWORD);
         apisecretInput->SetHint(_("API-Secret"));
-        apisecretInput->SetValue(settings.lastfm.api_secret);
+        apisecretInput->SetValue(settings->lastfm.api_secret);
         apisecretInput->Bind(wxEVT_TEXT, [this](wxCommandEvent& event) {
-            auto settings = utils::getSettings();
             std::string data = event.GetString().ToStdString();
-            settings.lastfm.api_secret = data;
-            utils::saveSettings(settings);
+            utils::updateSettings([&data](utils::Settings& settings) { settings.lastfm.api_secret = data; });
         });
 
         auto checkButton = new wxButton(panel, wxID_ANY, _("Check credentials"));
-        checkButton->Bind(wxEVT_BUTTON, [this](wxCommandEvent& event) { initLastFM(true); });
+        checkButton->Bind(wxEVT_BUTTON, [this](wxCommandEvent& event) {
+            if (pipeline::checkLastFM() == LastFM::SUCCESS)
+                wxMessageBox(_("The LastFM authentication was successful."), _("PlayerLink"),
+                             wxOK | wxICON_INFORMATION);
+            else
+                wxMessageBox(_("Error authenticating at LastFM!"), _("PlayerLink"), wxOK | wxICON_ERROR);
+        });
         mainContainer->Add(lastFMContainer, 0, 0, 5);
 
         mainContainer->Add(usernameInput, 0, wxEXPAND | wxALL, 5);
@@ -598,23 +454,19 @@ public:
 
         auto autostartCheckbox =
             new wxCheckBox(panel, wxID_ANY, _("Launch at login"), wxDefaultPosition, wxDefaultSize, 0);
-        autostartCheckbox->SetValue(settings.autoStart);
+        autostartCheckbox->SetValue(settings->autoStart);
         autostartCheckbox->Bind(wxEVT_CHECKBOX, [](wxCommandEvent& event) {
             bool isChecked = event.IsChecked();
-            auto settings = utils::getSettings();
-            settings.autoStart = isChecked;
             backend::toggleAutostart(isChecked);
-            utils::saveSettings(settings);
+            utils::updateSettings([isChecked](utils::Settings& settings) { settings.autoStart = isChecked; });
         });
 
         auto odesliCheckbox =
             new wxCheckBox(panel, wxID_ANY, _("Odesli integration"), wxDefaultPosition, wxDefaultSize, 0);
-        odesliCheckbox->SetValue(settings.odesli);
+        odesliCheckbox->SetValue(settings->odesli);
         odesliCheckbox->Bind(wxEVT_CHECKBOX, [](wxCommandEvent& event) {
             bool isChecked = event.IsChecked();
-            auto settings = utils::getSettings();
-            settings.odesli = isChecked;
-            utils::saveSettings(settings);
+            utils::updateSettings([isChecked](utils::Settings& settings) { settings.odesli = isChecked; });
         });
 
         settingsContainer->Add(autostartCheckbox, 0, wxALL, 5);
@@ -657,12 +509,12 @@ private:
             utils::App backupApp = *appData;
             EditAppDialog dlg{this, _("Edit application") + " " + appData->appName, appData};
             if (dlg.ShowModal() == wxID_OK) {
-                auto settings = utils::getSettings();
-                for (auto& app : settings.apps) {
-                    if (app == backupApp)
-                        app = *appData;
-                }
-                utils::saveSettings(settings);
+                utils::updateSettings([&backupApp, appData](utils::Settings& settings) {
+                    for (auto& app : settings.apps) {
+                        if (app == backupApp)
+                            app = *appData;
+                    }
+                });
                 checkbox->SetLabelText(appData->appName);
                 this->Layout();
             }
@@ -673,9 +525,10 @@ private:
         deleteButton->Bind(wxEVT_BUTTON,
                            [this, checkboxRowSizer, container, frameSizer, checkbox, size](wxCommandEvent& event) {
                                utils::App* appData = static_cast<utils::App*>(checkbox->GetClientData());
-                               auto settings = utils::getSettings();
-                               settings.apps.erase(std::find(settings.apps.begin(), settings.apps.end(), *appData));
-                               utils::saveSettings(settings);
+                               utils::updateSettings([appData](utils::Settings& settings) {
+                                   settings.apps.erase(
+                                       std::find(settings.apps.begin(), settings.apps.end(), *appData));
+                               });
                                container->Detach(checkboxRowSizer);
 
                                this->CallAfter([this, checkboxRowSizer, frameSizer, size]() {
@@ -706,16 +559,24 @@ public:
         if (wxSystemSettings::GetAppearance().IsSystemDark())  // To support the native dark mode on windows 10 and up
             this->SetAppearance(wxAppBase::Appearance::Dark);
 
-        wxInitAllImageHandlers();
-        wxIcon tray_icon = utils::loadIconFromMemory(menubar_icon_png, menubar_icon_png_size);
+        wxInitAllImageHandlers();  // before the pipeline starts decoding covers
+        pipeline::Options options;
+        options.thumbnailScaler = ui::scaleThumbnail;
+        pipeline::start(options);
+        wxIcon tray_icon = ui::loadIconFromMemory(menubar_icon_png, menubar_icon_png_size);
         PlayerLinkFrame* frame = new PlayerLinkFrame(nullptr, wxID_ANY, _("PlayerLink"));
         trayIcon = new PlayerLinkIcon(frame);
         frame->Bind(wxEVT_CLOSE_WINDOW, [=](wxCloseEvent& event) {
             if (event.CanVeto()) {
                 frame->Hide();
                 event.Veto();
-            } else
-                std::exit(0);
+            } else {
+                // same as the daemon: clear the presence and get the settings on disk, then leave without the static
+                // destructors, the media watcher is still blocked in the backend
+                pipeline::stop();
+                utils::flushSettings();
+                std::_Exit(0);
+            }
         });
 
         trayIcon->SetIcon(tray_icon, _("PlayerLink"));
@@ -728,10 +589,4 @@ private:
 
 wxIMPLEMENT_APP_NO_MAIN(PlayerLink);
 
-int main(int argc, char** argv) {
-    std::thread rpcThread(handleRPCTasks);
-    rpcThread.detach();
-    std::thread mediaThread(handleMediaTasks);
-    mediaThread.detach();
-    return wxEntry(argc, argv);
-}
\ No newline at end of file
+int main(int argc, char** argv) { return wxEntry(argc, argv); }
\ No newline at end of file
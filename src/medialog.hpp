@@ -0,0 +1,300 @@
+#ifndef _MEDIALOG_
+#define _MEDIALOG_
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include "mediasource.hpp"
+
+// a recorded session: every snapshot a source handed out, with the time it was taken. Records only carry the strings
+// that changed since the previous one, a track change costs its metadata once and everything else a handful of bytes.
+//   file:   "PLML" version
+//   record: varint microseconds since the previous record, flags, changed fields mask,
+//           the changed strings as varint length + bytes, the artists as varint count + strings if they changed,
+//           zigzag varint duration and elapsed time in ms, varint playback rate in thousandths
+namespace medialog {
+    constexpr char magic[4] = {'P', 'L', 'M', 'L'};
+    constexpr uint8_t version = 2;
+
+    enum Flags : uint8_t { PLAYING = 1, PAUSED = 2, ARTISTS = 4 };
+
+    // the strings in record order, the changed fields mask has one bit per entry
+    constexpr std::string MediaInfo::*fields[] = {
+        &MediaInfo::songTitle,      &MediaInfo::songArtist,        &MediaInfo::songAlbum, &MediaInfo::songArtUrl,
+        &MediaInfo::playbackSource, &MediaInfo::songThumbnailData, &MediaInfo::songUrl,   &MediaInfo::trackId};
+    constexpr size_t fieldCount = sizeof(fields) / sizeof(fields[0]);
+    static_assert(fieldCount <= 8, "the changed fields mask is a single byte");
+
+    inline void putVarint(std::string& out, uint64_t value) {
+        while (value >= 0x80) {
+            out += static_cast<char>((value & 0x7f) | 0x80);
+            value >>= 7;
+        }
+        out += static_cast<char>(value);
+    }
+
+    inline bool getVarint(const char*& p, const char* end, uint64_t& value) {
+        value = 0;
+        for (int shift = 0; p < end && shift < 64; shift += 7) {
+            uint8_t byte = static_cast<uint8_t>(*p++);
+            value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+            if (!(byte & 0x80))
+                return true;
+        }
+        return false;
+    }
+
+    // small negative numbers stay small, players do report negative positions now and then
+    inline uint64_t zigzag(int64_t value) {
+        return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+    }
+    inline int64_t unzigzag(uint64_t value) {
+        return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+    }
+
+    class Writer {
+    public:
+        bool open(const std::filesystem::path& file) {
+            out.open(file, std::ios::binary | std::ios::trunc);
+            out.write(magic, sizeof(magic));
+            out.put(static_cast<char>(version));
+            last = Clock::now();
+            return static_cast<bool>(out.flush());
+        }
+
+        void append(bool playing, const MediaInfo& media) {
+            auto now = Clock::now();
+            record.clear();
+            putVarint(record, std::chrono::duration_cast<std::chrono::microseconds>(now - last).count());
+            last = now;
+
+            bool artistsChanged = playing && media.songArtists != previous.songArtists;
+            record += static_cast<char>((playing ? PLAYING : 0) | (playing && media.paused ? PAUSED : 0) |
+                                        (artistsChanged ? ARTISTS : 0));
+            uint8_t changed = 0;
+            for (size_t i = 0; playing && i < fieldCount; i++) {
+                if (media.*fields[i] != previous.*fields[i])
+                    changed |= 1 << i;
+            }
+            record += static_cast<char>(changed);
+            for (size_t i = 0; i < fieldCount; i++) {
+                if (!(changed & (1 << i)))
+                    continue;
+                const std::string& value = media.*fields[i];
+                putVarint(record, value.size());
+                record += value;
+                previous.*fields[i] = value;
+            }
+            if (artistsChanged) {
+                putVarint(record, media.songArtists.size());
+                for (const auto& artist : media.songArtists) {
+                    putVarint(record, artist.size());
+                    record += artist;
+                }
+                previous.songArtists = media.songArtists;
+            }
+            putVarint(record, zigzag(playing ? media.songDuration : 0));
+            putVarint(record, zigzag(playing ? media.songElapsedTime : 0));
+            bool rated = playing && media.playbackRate > 0;
+            putVarint(record, rated ? static_cast<uint64_t>(std::llround(media.playbackRate * 1000)) : 1000);
+
+            // flushed every time, a session that ends in a crash is the one worth having
+            out.write(record.data(), record.size());
+            out.flush();
+        }
+
+    private:
+        using Clock = std::chrono::steady_clock;
+        std::ofstream out;
+        Clock::time_point last;
+        MediaInfo previous;
+        std::string record;
+    };
+
+    class Reader {
+    public:
+        bool open(const std::filesystem::path& file) {
+            std::ifstream in(file, std::ios::binary);
+            data.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+            if (data.size() < sizeof(magic) + 1 || std::memcmp(data.data(), magic, sizeof(magic)) != 0 ||
+                static_cast<uint8_t>(data[sizeof(magic)]) != version)
+                return false;
+            rewind();
+            return true;
+        }
+
+        void rewind() {
+            position = sizeof(magic) + 1;
+            media.reset();
+        }
+
+        // the next snapshot and how long after the previous one it was taken. False at the end of the log, a record
+        // cut short by a crash counts as the end.
+        bool next(std::chrono::microseconds& delay, bool& playing, const MediaInfo*& snapshot) {
+            const char* p = data.data() + position;
+            const char* end = data.data() + data.size();
+            uint64_t microseconds, length, count, duration, elapsed, rate;
+            if (!getVarint(p, end, microseconds) || end - p < 2)
+                return false;
+            uint8_t flags = static_cast<uint8_t>(*p++);
+            uint8_t changed = static_cast<uint8_t>(*p++);
+            for (size_t i = 0; i < fieldCount; i++) {
+                if (!(changed & (1 << i)))
+                    continue;
+                if (!getVarint(p, end, length) || static_cast<uint64_t>(end - p) < length)
+                    return false;
+                (media.*fields[i]).assign(p, length);
+                p += length;
+            }
+            if (flags & ARTISTS) {
+                if (!getVarint(p, end, count) || static_cast<uint64_t>(end - p) < count)
+                    return false;  // every artist takes at least a byte, a broken count can't make us allocate much
+                media.songArtists.resize(count);
+                for (auto& artist : media.songArtists) {
+                    if (!getVarint(p, end, length) || static_cast<uint64_t>(end - p) < length)
+                        return false;
+                    artist.assign(p, length);
+                    p += length;
+                }
+            }
+            if (!getVarint(p, end, duration) || !getVarint(p, end, elapsed) || !getVarint(p, end, rate))
+                return false;
+
+            position = p - data.data();
+            delay = std::chrono::microseconds(microseconds);
+            playing = flags & PLAYING;
+            media.paused = flags & PAUSED;
+            media.songDuration = unzigzag(duration);
+            media.songElapsedTime = unzigzag(elapsed);
+            media.playbackRate = rate / 1000.0;
+            snapshot = &media;
+            return true;
+        }
+
+    private:
+        std::string data;
+        size_t position = 0;
+        MediaInfo media;
+    };
+}  // namespace medialog
+
+// passes another source through and writes everything it hands out to a log
+class RecordingSource : public MediaSource {
+public:
+    RecordingSource(std::shared_ptr<MediaSource> source, const std::filesystem::path& file)
+        : source(std::move(source)) {
+        recording = writer.open(file);
+    }
+
+    bool isRecording() const { return recording; }
+
+    bool waitForMediaChange(std::chrono::milliseconds timeout) override {
+        return source->waitForMediaChange(timeout);
+    }
+
+    bool getMediaInformation(MediaInfo& mediaInfo) override {
+        bool playing = source->getMediaInformation(mediaInfo);
+        if (recording)
+            writer.append(playing, mediaInfo);
+        return playing;
+    }
+
+    void setPlayerPriority(const std::vector<std::string>& processNames) override {
+        source->setPlayerPriority(processNames);
+    }
+
+    bool needsEverySnapshot() const override { return source->needsEverySnapshot(); }
+
+private:
+    std::shared_ptr<MediaSource> source;
+    medialog::Writer writer;
+    bool recording = false;
+};
+
+// plays a log back with the original timing scaled by speed, or as fast as the pipeline takes it with a speed of 0.
+// At a speed of 0 every record reaches the pipeline, so a replay goes through the same steps every time. Combined
+// with another source that's no longer true, MediaSources only hands on the newest state of each. Nothing is playing
+// anymore once the log is over, unless it loops.
+class ReplaySource : public MediaSource {
+public:
+    ReplaySource(const std::filesystem::path& file, double speed = 1.0, bool loop = false)
+        : speed(speed), loop(loop) {
+        loaded = reader.open(file);
+        due = Clock::now();
+        advance();
+    }
+
+    bool isLoaded() const { return loaded; }
+
+    bool needsEverySnapshot() const override { return speed <= 0; }
+
+    bool waitForMediaChange(std::chrono::milliseconds timeout) override {
+        if (!hasNext) {
+            std::this_thread::sleep_for(timeout);
+            return false;
+        }
+        auto deadline = Clock::now() + timeout;
+        if (due > deadline) {
+            std::this_thread::sleep_until(deadline);
+            return false;
+        }
+        std::this_thread::sleep_until(due);
+        return true;
+    }
+
+    bool getMediaInformation(MediaInfo& mediaInfo) override {
+        if (hasNext && Clock::now() >= due) {
+            playing = nextPlaying;
+            if (next)
+                current = *next;
+            advance();
+        }
+        if (!playing)
+            return false;
+        mediaInfo = current;
+        return true;
+    }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    void advance() {
+        std::chrono::microseconds delay;
+        hasNext = loaded && reader.next(delay, nextPlaying, next);
+        if (!hasNext && loaded && loop) {
+            reader.rewind();
+            hasNext = reader.next(delay, nextPlaying, next);
+        } else if (!hasNext && loaded && !finished) {
+            // one more change right after the last record, the player went away with the end of the log
+            finished = true;
+            hasNext = true;
+            nextPlaying = false;
+            next = nullptr;
+            delay = std::chrono::microseconds(0);
+        }
+        if (hasNext && speed > 0)
+            due += std::chrono::duration_cast<Clock::duration>(delay / speed);
+    }
+
+    medialog::Reader reader;
+    double speed;
+    bool loop;
+    bool loaded = false;
+    bool hasNext = false;
+    bool finished = false;
+    bool nextPlaying = false;
+    const MediaInfo* next = nullptr;
+    Clock::time_point due;
+    bool playing = false;
+    MediaInfo current;
+};
+
+#endif
@@ -0,0 +1,139 @@
+#ifndef _MEDIASOURCE_
+#define _MEDIASOURCE_
+
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "backend.hpp"
+
+// something the pipeline gets its MediaInfo snapshots from. The platform backend is the usual one, others replay a
+// recorded session or take what another program sends. The pipeline only ever calls a source from one thread.
+class MediaSource {
+public:
+    virtual ~MediaSource() {}
+    // same contract as backend::waitForMediaChange()
+    virtual bool waitForMediaChange(std::chrono::milliseconds timeout) = 0;
+    // same contract as backend::getMediaInformation()
+    virtual bool getMediaInformation(MediaInfo& mediaInfo) = 0;
+    virtual void setPlayerPriority(const std::vector<std::string>& processNames) {}
+    // the pipeline only keeps the newest snapshot and drops the ones it didn't get to. A source that returns true here
+    // isn't asked for the next snapshot before the pipeline took the previous one, so every one of them arrives.
+    virtual bool needsEverySnapshot() const { return false; }
+};
+
+// the platform backend, backend::init() has to have succeeded
+class BackendSource : public MediaSource {
+public:
+    bool waitForMediaChange(std::chrono::milliseconds timeout) override {
+        return backend::waitForMediaChange(timeout);
+    }
+    bool getMediaInformation(MediaInfo& mediaInfo) override { return backend::getMediaInformation(mediaInfo); }
+    void setPlayerPriority(const std::vector<std::string>& processNames) override {
+        backend::setPlayerPriority(processNames);
+    }
+};
+
+// several sources at once. Every source gets a thread that waits for its changes, a change in any of them wakes up
+// the reader. The first source with something playing wins, then the first one with something paused, so the order
+// the sources were added in is their priority.
+class MediaSources : public MediaSource {
+public:
+    explicit MediaSources(std::vector<std::shared_ptr<MediaSource>> sources) : slots(sources.size()) {
+        for (size_t i = 0; i < sources.size(); i++)
+            slots[i].source = std::move(sources[i]);
+        for (size_t i = 0; i < slots.size(); i++) threads.emplace_back(&MediaSources::watch, this, i);
+    }
+
+    ~MediaSources() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        for (auto& thread : threads) thread.join();  // takes up to a second, that's how long the sources wait at most
+    }
+
+    MediaSources(const MediaSources&) = delete;
+    MediaSources& operator=(const MediaSources&) = delete;
+
+    bool waitForMediaChange(std::chrono::milliseconds timeout) override {
+        std::unique_lock<std::mutex> lock(mutex);
+        return changeSignal.wait_for(lock, timeout, [this] { return changed; });
+    }
+
+    bool getMediaInformation(MediaInfo& mediaInfo) override {
+        std::lock_guard<std::mutex> lock(mutex);
+        changed = false;
+        const Slot* best = nullptr;
+        for (const auto& slot : slots) {
+            if (slot.playing && (!best || (best->media.paused && !slot.media.paused)))
+                best = &slot;
+        }
+        if (!best)
+            return false;
+        mediaInfo = best->media;
+        return true;
+    }
+
+    // the sources are busy on their own threads, they pick this up before they're asked for their state next time
+    void setPlayerPriority(const std::vector<std::string>& processNames) override {
+        std::lock_guard<std::mutex> lock(mutex);
+        priority = processNames;
+        priorityVersion++;
+        for (auto& slot : slots) slot.refresh = true;
+        changeSignal.notify_all();
+    }
+
+private:
+    struct Slot {
+        std::shared_ptr<MediaSource> source;
+        MediaInfo media;
+        bool playing = false;
+        bool refresh = true;  // ask the source right away instead of waiting for a change
+    };
+
+    void watch(size_t index) {
+        std::shared_ptr<MediaSource> source = slots[index].source;
+        MediaInfo media;
+        uint64_t appliedPriority = 0;
+        while (true) {
+            bool refresh;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (stopping)
+                    return;
+                refresh = slots[index].refresh;
+                slots[index].refresh = false;
+                if (appliedPriority != priorityVersion) {
+                    appliedPriority = priorityVersion;
+                    source->setPlayerPriority(priority);
+                }
+            }
+
+            if (!refresh && !source->waitForMediaChange(std::chrono::seconds(1)))
+                continue;  // comes back every second to see if the priority changed or we're shutting down
+            bool playing = source->getMediaInformation(media);
+
+            std::lock_guard<std::mutex> lock(mutex);
+            std::swap(slots[index].media, media);  // swapped, so both buffers keep their capacity
+            slots[index].playing = playing;
+            changed = true;
+            changeSignal.notify_all();
+        }
+    }
+
+    std::mutex mutex;
+    std::condition_variable changeSignal;
+    std::vector<Slot> slots;
+    std::vector<std::thread> threads;
+    std::vector<std::string> priority;
+    uint64_t priorityVersion = 0;
+    bool changed = false;
+    bool stopping = false;
+};
+
+#endif
@@ -0,0 +1,225 @@
+#ifndef _METRICS_
+#define _METRICS_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "atomicfile.hpp"
+
+// counters and latency histograms for every stage between the player and discord/last.fm, so a late presence update
+// can be pinned on a stage. Off by default, a disabled timer costs one relaxed atomic load and nothing else.
+namespace metrics {
+    enum Stage {
+        POLL = 0,      // asking the backend for the current media
+        LOOP_WAIT,     // a snapshot waiting for the event loop to pick it up
+        TRACK_CHANGE,  // everything the pipeline does with a snapshot
+        SETTINGS,      // resolving the app settings for the playback source
+        ARTWORK,       // itunes lookup, cache hits included
+        LASTFM,        // now playing and scrobble requests
+        DISCORD,       // handing a presence to discord-rpc
+        STAGE_COUNT
+    };
+
+    inline const char* stageName(Stage stage) {
+        static const char* names[STAGE_COUNT] = {"poll", "loop_wait", "track_change", "settings",
+                                                 "artwork", "lastfm", "discord"};
+        return names[stage];
+    }
+
+    // upper bounds in microseconds, everything slower ends up in the +Inf bucket
+    constexpr int64_t bucketBounds[] = {100, 500, 1000, 5000, 10000, 50000, 100000, 500000, 1000000, 5000000};
+    constexpr size_t BUCKET_COUNT = sizeof(bucketBounds) / sizeof(bucketBounds[0]);
+    // the trace keeps the newest events only, so leaving it on for days doesn't eat memory
+    constexpr size_t MAX_TRACE_EVENTS = 20000;
+
+    using Clock = std::chrono::steady_clock;
+
+    struct StageStats {
+        std::atomic<uint64_t> count;
+        std::atomic<uint64_t> errors;
+        std::atomic<uint64_t> totalUs;
+        std::atomic<uint64_t> buckets[BUCKET_COUNT + 1];
+    };
+
+    struct TraceEvent {
+        Stage stage;
+        uint64_t thread;
+        int64_t startUs;
+        int64_t durationUs;
+    };
+
+    // both are constant initialized, so checking them doesn't go through a static init guard
+    inline std::atomic<bool>& enabledFlag() {
+        static std::atomic<bool> flag{false};
+        return flag;
+    }
+
+    inline std::atomic<bool>& tracingFlag() {
+        static std::atomic<bool> flag{false};
+        return flag;
+    }
+
+    inline bool enabled() { return enabledFlag().load(std::memory_order_relaxed); }
+    inline bool tracing() { return tracingFlag().load(std::memory_order_relaxed); }
+
+    inline StageStats* stats() {
+        static StageStats stageStats[STAGE_COUNT];  // zeroed, it has static storage
+        return stageStats;
+    }
+
+    inline std::mutex& traceMutex() {
+        static std::mutex mutex;
+        return mutex;
+    }
+
+    // ring buffer, traceNext() is where the next event goes once it is full
+    inline std::vector<TraceEvent>& traceEvents() {
+        static std::vector<TraceEvent> events;
+        return events;
+    }
+
+    inline size_t& traceNext() {
+        static size_t next = 0;
+        return next;
+    }
+
+    inline Clock::time_point startTime() {
+        static const Clock::time_point start = Clock::now();
+        return start;
+    }
+
+    inline void setEnabled(bool metricsEnabled, bool traceEnabled) {
+        startTime();
+        enabledFlag().store(metricsEnabled, std::memory_order_relaxed);
+        tracingFlag().store(metricsEnabled && traceEnabled, std::memory_order_relaxed);
+    }
+
+    inline void record(Stage stage, Clock::time_point start, Clock::time_point end, bool failed = false) {
+        if (!enabled())
+            return;
+        int64_t us = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+        if (us < 0)
+            us = 0;
+
+        StageStats& stageStats = stats()[stage];
+        stageStats.count.fetch_add(1, std::memory_order_relaxed);
+        stageStats.totalUs.fetch_add(static_cast<uint64_t>(us), std::memory_order_relaxed);
+        if (failed)
+            stageStats.errors.fetch_add(1, std::memory_order_relaxed);
+        size_t bucket = 0;
+        while (bucket < BUCKET_COUNT && us > bucketBounds[bucket]) bucket++;
+        stageStats.buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+
+        if (!tracing())
+            return;
+        TraceEvent event{stage, std::hash<std::thread::id>()(std::this_thread::get_id()),
+                         std::chrono::duration_cast<std::chrono::microseconds>(start - startTime()).count(), us};
+        std::lock_guard<std::mutex> lock(traceMutex());
+        auto& events = traceEvents();
+        if (events.size() < MAX_TRACE_EVENTS) {
+            events.push_back(event);
+        } else {
+            events[traceNext()] = event;
+            traceNext() = (traceNext() + 1) % MAX_TRACE_EVENTS;
+        }
+    }
+
+    // times the scope it lives in. Decides once at construction whether it records, so toggling the metrics midway
+    // can't produce half a measurement.
+    class ScopedTimer {
+    public:
+        explicit ScopedTimer(Stage stage) : stage(stage), active(enabled()) {
+            if (active)
+                start = Clock::now();
+        }
+        ~ScopedTimer() {
+            if (active)
+                record(stage, start, Clock::now(), failed);
+        }
+
+        ScopedTimer(const ScopedTimer&) = delete;
+        ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+        // counts the measurement as an error as well
+        void fail() { failed = true; }
+
+    private:
+        Stage stage;
+        bool active;
+        bool failed = false;
+        Clock::time_point start;
+    };
+
+    // prometheus text exposition format, point node_exporter's textfile collector at it or just cat it
+    inline std::string prometheusText() {
+        std::string out;
+        out += "# HELP playerlink_stage_errors_total Failed operations per pipeline stage.\n";
+        out += "# TYPE playerlink_stage_errors_total counter\n";
+        for (int i = 0; i < STAGE_COUNT; i++) {
+            out += "playerlink_stage_errors_total{stage=\"" + std::string(stageName(static_cast<Stage>(i))) + "\"} " +
+                   std::to_string(stats()[i].errors.load(std::memory_order_relaxed)) + "\n";
+        }
+
+        out += "# HELP playerlink_stage_duration_seconds Time spent per pipeline stage.\n";
+        out += "# TYPE playerlink_stage_duration_seconds histogram\n";
+        for (int i = 0; i < STAGE_COUNT; i++) {
+            const StageStats& stageStats = stats()[i];
+            std::string label = "stage=\"" + std::string(stageName(static_cast<Stage>(i))) + "\"";
+            uint64_t cumulative = 0;
+            for (size_t bucket = 0; bucket <= BUCKET_COUNT; bucket++) {
+                cumulative += stageStats.buckets[bucket].load(std::memory_order_relaxed);
+                std::string bound =
+                    bucket < BUCKET_COUNT ? std::to_string(bucketBounds[bucket] / 1e6) : std::string("+Inf");
+                out += "playerlink_stage_duration_seconds_bucket{" + label + ",le=\"" + bound + "\"} " +
+                       std::to_string(cumulative) + "\n";
+            }
+            out += "playerlink_stage_duration_seconds_sum{" + label + "} " +
+                   std::to_string(stageStats.totalUs.load(std::memory_order_relaxed) / 1e6) + "\n";
+            out += "playerlink_stage_duration_seconds_count{" + label + "} " +
+                   std::to_string(stageStats.count.load(std::memory_order_relaxed)) + "\n";
+        }
+        return out;
+    }
+
+    // chrome trace event format, open it in chrome://tracing or ui.perfetto.dev
+    inline std::string traceJson() {
+        std::vector<TraceEvent> events;
+        size_t next;
+        {
+            std::lock_guard<std::mutex> lock(traceMutex());
+            events = traceEvents();
+            next = traceNext();
+        }
+
+        std::string out = "{\"traceEvents\":[";
+        for (size_t i = 0; i < events.size(); i++) {
+            const TraceEvent& event = events[(next + i) % events.size()];  // oldest first
+            if (i)
+                out += ",";
+            out += "\n{\"name\":\"" + std::string(stageName(event.stage)) +
+                   "\",\"ph\":\"X\",\"pid\":1,\"tid\":" + std::to_string(event.thread % 100000) +
+                   ",\"ts\":" + std::to_string(event.startUs) + ",\"dur\":" + std::to_string(event.durationUs) + "}";
+        }
+        out += "\n],\"displayTimeUnit\":\"ms\"}\n";
+        return out;
+    }
+
+    // metrics.prom and, while tracing, trace.json in the given directory. Replaced as a whole, whoever scrapes them
+    // never sees half a file.
+    inline void dump(const std::filesystem::path& directory) {
+        if (!enabled())
+            return;
+        atomicfile::replace(directory / "metrics.prom", prometheusText());
+        if (tracing())
+            atomicfile::replace(directory / "trace.json", traceJson());
+    }
+}  // namespace metrics
+
+#endif
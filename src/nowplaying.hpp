@@ -0,0 +1,41 @@
+#ifndef _NOWPLAYING_
+#define _NOWPLAYING_
+
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "thumbnail.hpp"
+#include "utils.hpp"
+
+// what the tray and the dialogs show about the current track
+struct NowPlaying {
+    std::string title;   // "artist - title", empty while nothing is playing
+    std::string source;  // playback source of the last track, stays set while paused
+    utils::SongInfo songInfo{};
+    std::shared_ptr<const Thumbnail> thumbnail;  // cover of the current track, if the player provided a local one
+};
+
+// the pipeline publishes a new immutable snapshot for every change and readers just grab the current pointer, so the
+// ui never waits on the pipeline and never sees a string that is halfway through being written
+class NowPlayingState {
+public:
+    std::shared_ptr<const NowPlaying> get() const { return std::atomic_load(&current); }
+
+    // copies the current snapshot, applies the change to the copy and publishes it. Nothing is published if the
+    // change returns false.
+    template <typename F>
+    void update(F&& change) {
+        std::lock_guard<std::mutex> lock(writeMutex);
+        NowPlaying next = *get();
+        if (!change(next))
+            return;
+        std::atomic_store(&current, std::make_shared<const NowPlaying>(std::move(next)));
+    }
+
+private:
+    std::mutex writeMutex;
+    std::shared_ptr<const NowPlaying> current = std::make_shared<const NowPlaying>();
+};
+
+#endif
@@ -0,0 +1,455 @@
+#include "pipeline.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <future>
+#include <mutex>
+#include <thread>
+
+#include "artwork.hpp"
+#include "backend.hpp"
+#include "discord.hpp"
+#include "metrics.hpp"
+#include "playbackclock.hpp"
+#include "presence.hpp"
+#include "scheduler.hpp"
+#include "scrobbler.hpp"
+#include "thumbnail.hpp"
+#include "trackkey.hpp"
+#include "utils.hpp"
+
+namespace {
+    TrackKey lastTrack;
+    std::string lastMediaSource = "";
+    NowPlayingState nowPlaying;
+    utils::LastFMSettings lastfmAccount{};  // what the scrobble queue's client logs in with, if it has one
+    ScrobbleTracker scrobbleTracker;
+
+    // everything needed to build the presence again once the artwork lookup finished
+    struct PresenceState {
+        TrackKey trackKey;
+        MediaInfo media;
+        std::shared_ptr<const utils::Settings> settings;  // keeps app alive
+        const utils::App* app = nullptr;
+        utils::SongInfo songInfo;
+        bool odesli = false;
+        int64_t startTimestamp = 0;
+        int64_t endTimestamp = 0;
+    };
+
+    // everything that owns a thread is created by start() and never destroyed. Nothing may start a thread during
+    // static initialization, the daemon blocks its signals before start(), and the static destructors must not tear
+    // these down while the loop thread or a worker in the middle of a request still uses them.
+    EventLoop* eventLoop = nullptr;
+    ArtworkLookup* artworkLookup = nullptr;
+    DiscordConnection* discordConnection = nullptr;
+    ScrobbleQueue* scrobbleQueue = nullptr;
+    PresenceManager* presenceManager = nullptr;
+    ThumbnailLoader* thumbnailLoader = nullptr;  // only there if the ui can show thumbnails
+
+    // the media pipeline, the discord pump and artwork results all run on the event loop, so the state below is only
+    // ever touched from its thread
+    PresenceState presence;
+    MediaInfo currentMedia;
+    bool hasMedia = false;
+    EventLoop::Clock::time_point currentMediaAt;
+    // where the published presence thinks the track is. Only running while something plays, a snapshot that doesn't
+    // fit it is a seek and the timestamps have to be sent again.
+    PlaybackClock trackClock;
+    bool trackClockRunning = false;
+    EventLoop::TimerId scrobbleTimer = 0;
+    EventLoop::TimerId pumpTimer = 0;
+    EventLoop::TimerId metricsTimer = 0;
+    bool discordSocketWatched = false;
+    pipeline::Options options;
+    TrackKey thumbnailTrack;
+    std::string thumbnailArtUrl;
+    uint64_t thumbnailRequest = 0;
+
+    void applyMetricsSettings(const utils::Settings& settings) {
+        const char* env = std::getenv("PLAYERLINK_METRICS");
+        bool fromEnv = env && *env && std::strcmp(env, "0") != 0;
+        bool traceFromEnv = env && std::strcmp(env, "trace") == 0;
+        metrics::setEnabled(settings.metrics.enabled || fromEnv, settings.metrics.trace || traceFromEnv);
+
+        // the dump only wakes the loop while there is something to write
+        if (metrics::enabled() && !metricsTimer) {
+            metricsTimer =
+                eventLoop->every(std::chrono::seconds(10), [] { metrics::dump(backend::getConfigDirectory()); });
+        } else if (!metrics::enabled() && metricsTimer) {
+            eventLoop->cancel(metricsTimer);
+            metricsTimer = 0;
+        }
+    }
+
+    // discord-rpc only needs pumping while it connects or is connected. Otherwise the socket watcher, the next track
+    // or, without a watcher, the reconnect backoff bring us back, so nothing wakes up while discord is closed.
+    void pumpDiscord() {
+        if (discordConnection->getClientId().empty())
+            discordConnection->setClientId(utils::getApp(*utils::getSettings(), lastMediaSource).clientId);
+        discordConnection->pump();
+
+        eventLoop->cancel(pumpTimer);
+        pumpTimer = 0;
+        auto now = EventLoop::Clock::now();
+        auto due = discordConnection->nextPump(discordSocketWatched, now);
+        if (due != EventLoop::Clock::time_point::max())
+            pumpTimer = eventLoop->postDelayed(std::chrono::ceil<std::chrono::milliseconds>(due - now), pumpDiscord);
+    }
+
+    // hands the account from the settings to the scrobble queue, which logs in on its own thread and backs off while
+    // last.fm can't be reached. Only a changed account replaces the client, nothing here touches the network.
+    void applyLastFMSettings(const utils::Settings& settings) {
+        bool enabled = settings.lastfm.enabled && options.scrobbling;
+        const auto& account = settings.lastfm;
+        bool changed = enabled != lastfmAccount.enabled || account.username != lastfmAccount.username ||
+                       account.password != lastfmAccount.password || account.api_key != lastfmAccount.api_key ||
+                       account.api_secret != lastfmAccount.api_secret;
+        if (!changed)
+            return;
+        lastfmAccount = account;
+        lastfmAccount.enabled = enabled;
+        scrobbleQueue->setClient(enabled ? std::make_shared<LastFM>(account.username, account.password,
+                                                                    account.api_key, account.api_secret)
+                                         : nullptr);
+    }
+
+    void publishPresence(const PresenceState& state) {
+        const MediaInfo& media = state.media;
+        const utils::App& app = *state.app;
+        std::string serviceName = app.appName;
+
+        PresencePayload activity;
+        activity.type = app.type;
+        activity.displayType = app.displayType;
+        activity.details = media.songTitle;
+        activity.state = media.songArtist;
+        for (size_t i = 1; i < media.songArtists.size(); i++) activity.state += ", " + media.songArtists[i];
+        activity.smallImageText = serviceName;
+
+        activity.smallImageKey = "appicon";
+        if (state.songInfo.artworkURL == "") {
+            activity.smallImageKey = "";
+            activity.largeImageKey = "appicon";
+        } else {
+            activity.largeImageKey = state.songInfo.artworkURL;
+        }
+        activity.largeImageText = media.songAlbum;
+
+        activity.startTimestamp = state.startTimestamp;
+        activity.endTimestamp = state.endTimestamp;
+        std::string endpointURL = app.searchEndpoint;
+
+        std::string searchQuery = media.songTitle + " " + media.songArtist;
+        if (endpointURL != "") {
+            activity.button1name = "Search on " + serviceName;
+            activity.button1link = endpointURL + utils::urlEncode(searchQuery);
+        }
+
+        if (state.odesli && state.songInfo.artworkURL != "") {
+            activity.button2name = "Show on Song.link";
+            activity.button2link = utils::getOdesliURL(state.songInfo);
+        }
+
+        presenceManager->update(std::move(activity));
+    }
+
+    void clearPresence() {
+        artworkLookup->cancel();
+        presence.trackKey.reset();
+        presenceManager->clear();
+    }
+
+    void setNowPlayingTitle(const std::string& title, const std::string& source) {
+        nowPlaying.update([&title, &source](NowPlaying& state) {
+            if (state.title == title && state.source == source)
+                return false;
+            state.title = title;
+            state.source = source;
+            return true;
+        });
+    }
+
+    void setNowPlayingSongInfo(const utils::SongInfo& info) {
+        nowPlaying.update([&info](NowPlaying& state) {
+            state.songInfo = info;
+            return true;
+        });
+    }
+
+    // the cover can change without the track changing, e.g. when a player fetches it after announcing the track
+    void updateThumbnail(const MediaInfo& media) {
+        if (!thumbnailLoader || (thumbnailTrack.matches(media) && thumbnailArtUrl == media.songArtUrl))
+            return;
+        thumbnailTrack.assign(media);
+        thumbnailArtUrl = media.songArtUrl;
+        auto onLoaded = [request = ++thumbnailRequest](std::shared_ptr<const Thumbnail> thumbnail) {
+            eventLoop->post([request, thumbnail] {
+                if (request != thumbnailRequest)
+                    return;  // the next cover was already requested
+                nowPlaying.update([&thumbnail](NowPlaying& state) {
+                    state.thumbnail = thumbnail;
+                    return true;
+                });
+            });
+        };
+        thumbnailLoader->request(media.songArtUrl, media.songThumbnailData, onLoaded);
+    }
+
+    void refreshMedia();
+
+    // mediaInformation is null while nothing is playing
+    void handleMediaUpdate(const MediaInfo* mediaInformation) {
+        metrics::ScopedTimer timer(metrics::TRACK_CHANGE);
+        eventLoop->cancel(scrobbleTimer);
+        scrobbleTimer = 0;
+
+        auto settings = utils::getSettings();
+        if (!mediaInformation) {
+            scrobbleTracker.stop();
+            setNowPlayingTitle("", lastMediaSource);
+            clearPresence();  // Nothing is playing rn, clear presence
+            return;
+        }
+
+        // has to see paused and seeking ticks as well, so this happens before anything below skips them. Queued
+        // whether we're logged in or not, the journal keeps them until the queue has a client that is.
+        auto scrobbleEvents = scrobbleTracker.feed(*mediaInformation, currentMediaAt);
+        if (settings->lastfm.enabled && options.scrobbling &&
+            utils::isAppEnabled(*settings, mediaInformation->playbackSource)) {
+            if (scrobbleEvents.nowPlaying)
+                scrobbleQueue->nowPlaying(scrobbleTracker.current());
+            if (scrobbleEvents.scrobble)
+                scrobbleQueue->enqueue(scrobbleTracker.current());
+        }
+
+        // players don't report anything while a track just keeps playing, so come back once it's worth a scrobble
+        int64_t untilScrobble = scrobbleTracker.remainingMs();
+        if (!mediaInformation->paused && untilScrobble >= 0)
+            scrobbleTimer = eventLoop->postDelayed(std::chrono::milliseconds(untilScrobble + 250), refreshMedia);
+
+        if (mediaInformation->paused) {
+            trackClockRunning = false;
+            setNowPlayingTitle("", lastMediaSource);
+            clearPresence();
+            return;
+        }
+
+        updateThumbnail(*mediaInformation);
+        bool sameTrack = lastTrack.matches(*mediaInformation);
+        bool shouldContinue = sameTrack && trackClockRunning &&
+                              trackClock.getRate() == mediaInformation->playbackRate &&
+                              !trackClock.jumped(mediaInformation->songElapsedTime, currentMediaAt);
+        if (shouldContinue)
+            return;
+        trackClock.start(mediaInformation->songElapsedTime, false, mediaInformation->playbackRate,
+                         mediaInformation->songDuration, currentMediaAt);
+        trackClockRunning = true;
+
+        lastMediaSource = mediaInformation->playbackSource;
+        const utils::App* app;
+        {
+            metrics::ScopedTimer settingsTimer(metrics::SETTINGS);
+            app = &utils::getApp(*settings, lastMediaSource);
+        }
+
+        if (!sameTrack)
+            lastTrack.assign(*mediaInformation);
+        setNowPlayingTitle(mediaInformation->songArtist + " - " + mediaInformation->songTitle, lastMediaSource);
+
+        if (!app->enabled) {
+            clearPresence();
+            return;
+        }
+
+        // the presence keeps going out through the current connection until the switch actually happens. The pump
+        // times the switch, and reconnects if discord went away and its socket can't be watched.
+        discordConnection->requestClientId(app->clientId);
+        pumpDiscord();
+
+        // publish right away with the app icon, the artwork follows as soon as the lookup is done
+        if (presence.trackKey != lastTrack) {
+            presence.trackKey = lastTrack;
+            presence.songInfo = {};
+            std::string query =
+                mediaInformation->songTitle + " " + mediaInformation->songArtist + " " + mediaInformation->songAlbum;
+            // discord can only show a cover it can download, local ones still need the lookup. A remote one is good
+            // enough unless song.link is on, that needs the itunes track id.
+            bool remoteArt = mediaInformation->songArtUrl.compare(0, 8, "https://") == 0 ||
+                             mediaInformation->songArtUrl.compare(0, 7, "http://") == 0;
+            if (remoteArt && !settings->odesli) {
+                presence.songInfo.artworkURL = mediaInformation->songArtUrl;
+                artworkLookup->cancel();
+            } else if (artworkLookup->getCached(query, presence.songInfo)) {
+                artworkLookup->cancel();
+            } else {
+                artworkLookup->request(query, [key = lastTrack](const utils::SongInfo& info) {
+                    eventLoop->post([key, info] {
+                        if (presence.trackKey != key)
+                            return;  // the track changed while we were looking it up
+                        presence.songInfo = info;
+                        setNowPlayingSongInfo(info);
+                        publishPresence(presence);
+                    });
+                });
+            }
+            setNowPlayingSongInfo(presence.songInfo);
+        }
+
+        presence.media = *mediaInformation;
+        presence.settings = settings;
+        presence.app = app;
+        presence.odesli = settings->odesli;
+        presence.startTimestamp = 0;
+        presence.endTimestamp = 0;
+        // discord runs the bar in real time, so at 1.5x the track has to look two thirds as long
+        double rate = mediaInformation->playbackRate > 0 ? mediaInformation->playbackRate : 1.0;
+        if (mediaInformation->songDuration != 0) {
+            auto elapsedTime = static_cast<int64_t>(mediaInformation->songElapsedTime / rate);
+            auto remainingTime =
+                static_cast<int64_t>((mediaInformation->songDuration - mediaInformation->songElapsedTime) / rate);
+            presence.startTimestamp = time(nullptr) - (elapsedTime / 1000);
+            presence.endTimestamp = time(nullptr) + (remainingTime / 1000);
+        }
+        publishPresence(presence);
+    }
+
+    // runs the pipeline again on the last snapshot, moved forward by the time that passed since it was taken
+    void refreshMedia() {
+        auto now = EventLoop::Clock::now();
+        if (hasMedia && !currentMedia.paused) {
+            PlaybackClock clock;
+            clock.start(currentMedia.songElapsedTime, false, currentMedia.playbackRate, currentMedia.songDuration,
+                        currentMediaAt);
+            currentMedia.songElapsedTime = clock.position(now);
+        }
+        currentMediaAt = now;
+        handleMediaUpdate(hasMedia ? &currentMedia : nullptr);
+    }
+
+    // snapshots travel from the watcher thread to the event loop through this slot. The MediaInfo buffers get swapped
+    // instead of copied, so once their strings are large enough a poll doesn't allocate anything. A snapshot the loop
+    // hasn't picked up yet is simply replaced by the newer one, unless the source needs every snapshot to arrive.
+    std::mutex mediaSlotMutex;
+    std::condition_variable mediaSlotTaken;
+    MediaInfo mediaSlot;
+    bool mediaSlotPlaying = false;
+    bool mediaSlotPending = false;
+    metrics::Clock::time_point mediaSlotAt;
+
+    void takeMediaUpdate() {
+        {
+            std::lock_guard<std::mutex> lock(mediaSlotMutex);
+            std::swap(currentMedia, mediaSlot);
+            hasMedia = mediaSlotPlaying;
+            mediaSlotPending = false;
+            metrics::record(metrics::LOOP_WAIT, mediaSlotAt, metrics::Clock::now());
+        }
+        mediaSlotTaken.notify_one();
+        currentMediaAt = EventLoop::Clock::now();
+        handleMediaUpdate(hasMedia ? &currentMedia : nullptr);
+    }
+
+    // the only thread talking to the media source. It sleeps until the player reports a change and hands the new state
+    // to the event loop, so nothing wakes up while nothing is playing.
+    void watchMedia(std::shared_ptr<MediaSource> source) {
+        std::shared_ptr<const utils::Settings> lastSettings;
+        MediaInfo mediaInformation;
+        bool everySnapshot = source->needsEverySnapshot();
+        while (true) {
+            auto settings = utils::getSettings();
+            if (settings != lastSettings) {
+                source->setPlayerPriority(utils::getProcessNames(*settings));
+                lastSettings = settings;
+            }
+
+            if (!source->waitForMediaChange(std::chrono::seconds(30)))
+                continue;
+            bool playing;
+            {
+                metrics::ScopedTimer timer(metrics::POLL);
+                playing = source->getMediaInformation(mediaInformation);
+            }
+
+            bool wasPending;
+            {
+                std::lock_guard<std::mutex> lock(mediaSlotMutex);
+                std::swap(mediaInformation, mediaSlot);
+                mediaSlotPlaying = playing;
+                wasPending = mediaSlotPending;
+                mediaSlotPending = true;
+                if (!wasPending)
+                    mediaSlotAt = metrics::Clock::now();
+            }
+            if (!wasPending)
+                eventLoop->post(takeMediaUpdate);
+            if (everySnapshot) {
+                std::unique_lock<std::mutex> lock(mediaSlotMutex);
+                mediaSlotTaken.wait(lock, [] { return !mediaSlotPending; });
+            }
+        }
+    }
+}  // namespace
+
+void pipeline::start(const Options& pipelineOptions) {
+    options = pipelineOptions;
+    eventLoop = new EventLoop();
+    artworkLookup = new ArtworkLookup();
+    discordConnection = new DiscordConnection();
+    scrobbleQueue = new ScrobbleQueue(backend::getConfigDirectory() / "scrobbles.tsv");
+    presenceManager =
+        new PresenceManager(*eventLoop, std::chrono::seconds(4), [](bool visible, const PresencePayload& payload) {
+            discordConnection->show(visible, payload);
+        });
+    if (options.thumbnailScaler)
+        thumbnailLoader = new ThumbnailLoader(options.thumbnailScaler);
+    utils::onSettingsChanged([] {
+        eventLoop->post([] {
+            applyMetricsSettings(*utils::getSettings());
+            applyLastFMSettings(*utils::getSettings());
+            lastTrack.reset();  // make the presence pick up the new settings right away
+            refreshMedia();
+        });
+    });
+    eventLoop->post(pumpDiscord);  // connect right away, the pump keeps itself going from there
+    discordSocketWatched = backend::watchDiscordSocket([] {
+        discordConnection->socketAppeared();
+        eventLoop->post(pumpDiscord);
+    });
+    eventLoop->post([] {
+        applyMetricsSettings(*utils::getSettings());
+        applyLastFMSettings(*utils::getSettings());
+    });
+    std::thread eventThread([] { eventLoop->run(); });
+    eventThread.detach();
+    std::thread mediaThread(watchMedia, options.mediaSource ? options.mediaSource : std::make_shared<BackendSource>());
+    mediaThread.detach();
+}
+
+void pipeline::stop() {
+    std::promise<void> done;
+    eventLoop->post([&done] {
+        artworkLookup->cancel();
+        if (thumbnailLoader)
+            thumbnailLoader->cancel();
+        discordConnection->show(false, {});
+        discordConnection->shutdown();
+        metrics::dump(backend::getConfigDirectory());
+        eventLoop->stop();
+        done.set_value();
+    });
+    done.get_future().wait();
+}
+
+std::shared_ptr<const NowPlaying> pipeline::getNowPlaying() { return nowPlaying.get(); }
+
+// on the caller's thread, the event loop never waits for last.fm
+LastFM::LASTFM_STATUS pipeline::checkLastFM() {
+    auto settings = utils::getSettings();
+    LastFM lastfm(settings->lastfm.username, settings->lastfm.password, settings->lastfm.api_key,
+                  settings->lastfm.api_secret);
+    return lastfm.authenticate();
+}
@@ -0,0 +1,30 @@
+#ifndef _PIPELINE_
+#define _PIPELINE_
+
+#include <memory>
+
+#include "lastfm.hpp"
+#include "mediasource.hpp"
+#include "nowplaying.hpp"
+#include "thumbnail.hpp"
+
+// everything between the platform backend and discord/last.fm. The tray application and the headless daemon both run
+// it, the only difference is what sits on top.
+namespace pipeline {
+    struct Options {
+        bool scrobbling = true;  // false keeps last.fm off, whatever the settings say
+        ThumbnailLoader::Scaler thumbnailScaler;  // decodes covers for the tray, no thumbnails without one
+        std::shared_ptr<MediaSource> mediaSource;  // the platform backend if not set
+    };
+
+    // starts the event loop, the workers and the thread watching the media source, none of them exist before.
+    // backend::init() has to have succeeded already when the backend is the source.
+    void start(const Options& options = {});
+    // clears the presence and disconnects from discord. Blocks until that happened, the pipeline is dead afterwards.
+    void stop();
+    std::shared_ptr<const NowPlaying> getNowPlaying();
+    // logs in with the credentials from the settings even if last.fm is disabled, blocks until the answer is there
+    LastFM::LASTFM_STATUS checkLastFM();
+}  // namespace pipeline
+
+#endif
@@ -0,0 +1,73 @@
+#ifndef _PLAYBACKCLOCK_
+#define _PLAYBACKCLOCK_
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+
+// where a player is in the current track without asking it. Players only tell us the position when it does something
+// unexpected (a new track, a seek, play/pause, a different rate), in between it moves at the rate from the last of
+// those. Everything in milliseconds of track time.
+class PlaybackClock {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // the player said where it is, the rate and play state stay as they are
+    void seek(int64_t positionMs, Clock::time_point now = Clock::now()) {
+        anchorMs = positionMs;
+        anchorAt = now;
+    }
+
+    // anchors everything at once, for a new track or a full snapshot of the player
+    void start(int64_t positionMs, bool paused, double rate, int64_t durationMs, Clock::time_point now = Clock::now()) {
+        seek(positionMs, now);
+        this->paused = paused;
+        this->rate = rate > 0 ? rate : 1.0;
+        duration = durationMs;
+    }
+
+    // play/pause and rate changes only apply from now on, everything before ran the old way
+    void setPaused(bool paused, Clock::time_point now = Clock::now()) {
+        if (paused == this->paused)
+            return;
+        seek(position(now), now);
+        this->paused = paused;
+    }
+
+    void setRate(double rate, Clock::time_point now = Clock::now()) {
+        if (rate <= 0 || rate == this->rate)
+            return;
+        seek(position(now), now);
+        this->rate = rate;
+    }
+
+    void setDuration(int64_t durationMs) { duration = durationMs; }
+
+    int64_t position(Clock::time_point now = Clock::now()) const {
+        if (paused || now <= anchorAt)
+            return anchorMs;
+        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(now - anchorAt).count();
+        int64_t position = anchorMs + static_cast<int64_t>(elapsed * rate);
+        if (duration > 0 && position > duration)
+            position = duration;
+        return position;
+    }
+
+    // whether a player that reports positionMs at now can't have just kept playing since the anchor, i.e. someone
+    // seeked. The tolerance covers the time a report spends on its way to us.
+    bool jumped(int64_t positionMs, Clock::time_point now = Clock::now(), int64_t toleranceMs = 1000) const {
+        return std::llabs(positionMs - position(now)) > toleranceMs;
+    }
+
+    bool isPaused() const { return paused; }
+    double getRate() const { return rate; }
+
+private:
+    int64_t anchorMs = 0;
+    Clock::time_point anchorAt;
+    double rate = 1.0;
+    bool paused = false;
+    int64_t duration = 0;
+};
+
+#endif
@@ -0,0 +1,176 @@
+#ifndef _PRESENCE_
+#define _PRESENCE_
+#include <discord-rpc/discord_rpc.h>
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <string>
+
+#include "metrics.hpp"
+#include "scheduler.hpp"
+
+// owning copy of everything that ends up in a DiscordRichPresence, so payloads can be stored and compared
+struct PresencePayload {
+    int type = 0;
+    int displayType = 0;
+    std::string details;
+    std::string state;
+    std::string smallImageKey;
+    std::string smallImageText;
+    std::string largeImageKey;
+    std::string largeImageText;
+    int64_t startTimestamp = 0;
+    int64_t endTimestamp = 0;
+    std::string button1name;
+    std::string button1link;
+    std::string button2name;
+    std::string button2link;
+
+    bool operator==(const PresencePayload& other) const {
+        return type == other.type && displayType == other.displayType && details == other.details &&
+               state == other.state && smallImageKey == other.smallImageKey &&
+               smallImageText == other.smallImageText && largeImageKey == other.largeImageKey &&
+               largeImageText == other.largeImageText && startTimestamp == other.startTimestamp &&
+               endTimestamp == other.endTimestamp && button1name == other.button1name &&
+               button1link == other.button1link && button2name == other.button2name &&
+               button2link == other.button2link;
+    }
+    bool operator!=(const PresencePayload& other) const { return !(*this == other); }
+};
+
+// sits in front of Discord_UpdatePresence/Discord_ClearPresence. Discord drops presence updates that come in too
+// fast, so payloads identical to what was sent last are skipped and everything within rateWindow of the last send
+// gets coalesced: only the newest state is sent once the window is over. Lives on the event loop, the end of the
+// window is a timer on it and everything including the sender runs on the loop's thread.
+class PresenceManager {
+public:
+    struct Stats {
+        uint64_t sent;
+        uint64_t coalesced;
+        uint64_t skipped;
+    };
+
+    // gets called from the loop's thread, by default it talks to discord-rpc directly
+    using Sender = std::function<void(bool visible, const PresencePayload& payload)>;
+
+    PresenceManager(EventLoop& loop, std::chrono::milliseconds rateWindow = std::chrono::seconds(4),
+                    Sender sender = send)
+        : loop(loop), rateWindow(rateWindow), sender(std::move(sender)) {}
+
+    ~PresenceManager() { loop.cancel(windowTimer); }
+
+    PresenceManager(const PresenceManager&) = delete;
+    PresenceManager& operator=(const PresenceManager&) = delete;
+
+    void update(PresencePayload payload) { setDesired(true, std::move(payload)); }
+
+    void clear() { setDesired(false, {}); }
+
+    Stats stats() const { return {sentCount.load(), coalescedCount.load(), skippedCount.load()}; }
+
+    static void send(bool visible, const PresencePayload& payload) {
+        metrics::ScopedTimer timer(metrics::DISCORD);
+        if (!visible) {
+            Discord_ClearPresence();
+            return;
+        }
+
+        DiscordRichPresence activity{};
+        activity.type = payload.type;
+        activity.displayType = payload.displayType;
+        activity.details = payload.details.c_str();
+        activity.state = payload.state.c_str();
+        activity.smallImageKey = payload.smallImageKey.c_str();
+        activity.smallImageText = payload.smallImageText.c_str();
+        activity.largeImageKey = payload.largeImageKey.c_str();
+        activity.largeImageText = payload.largeImageText.c_str();
+        activity.startTimestamp = payload.startTimestamp;
+        activity.endTimestamp = payload.endTimestamp;
+        if (payload.button1name != "") {
+            activity.button1name = payload.button1name.c_str();
+            activity.button1link = payload.button1link.c_str();
+        }
+        if (payload.button2name != "") {
+            activity.button2name = payload.button2name.c_str();
+            activity.button2link = payload.button2link.c_str();
+        }
+        Discord_UpdatePresence(&activity);
+    }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    bool matchesSent(bool visible, const PresencePayload& payload) const {
+        return sentKnown && visible == sentVisible && (!visible || payload == sent);
+    }
+
+    void setDesired(bool visible, PresencePayload payload) {
+        if (matchesSent(visible, payload)) {
+            // back to what discord already shows, a pending update became pointless
+            if (dirty)
+                coalescedCount++;
+            else
+                skippedCount++;
+            desiredVisible = visible;
+            desired = std::move(payload);
+            dirty = false;
+            return;
+        }
+        if (dirty) {
+            if (visible == desiredVisible && (!visible || payload == desired)) {
+                skippedCount++;
+                return;
+            }
+            coalescedCount++;  // replaces a pending update that never made it out
+        }
+
+        desiredVisible = visible;
+        desired = std::move(payload);
+        dirty = true;
+        if (windowTimer)
+            return;  // goes out when the window is over
+
+        Clock::time_point now = Clock::now();
+        Clock::time_point allowedAt = lastSend + rateWindow;
+        if (now >= allowedAt) {
+            sendDesired(now);
+            return;
+        }
+        windowTimer = loop.postDelayed(std::chrono::ceil<std::chrono::milliseconds>(allowedAt - now), [this] {
+            windowTimer = 0;
+            if (dirty)
+                sendDesired(Clock::now());
+        });
+    }
+
+    void sendDesired(Clock::time_point now) {
+        dirty = false;
+        sentKnown = true;
+        sentVisible = desiredVisible;
+        sent = desired;
+        lastSend = now;
+        sender(sentVisible, sent);
+        sentCount++;
+    }
+
+    EventLoop& loop;
+    std::chrono::milliseconds rateWindow;
+    Sender sender;
+    EventLoop::TimerId windowTimer = 0;
+
+    bool dirty = false;  // desired differs from what was sent and is waiting for the rate window
+    bool desiredVisible = false;
+    PresencePayload desired;
+
+    bool sentKnown = true;  // nothing is shown before the first update
+    bool sentVisible = false;
+    PresencePayload sent;
+    Clock::time_point lastSend;
+
+    std::atomic<uint64_t> sentCount{0};
+    std::atomic<uint64_t> coalescedCount{0};
+    std::atomic<uint64_t> skippedCount{0};
+};
+
+#endif
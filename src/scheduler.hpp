@@ -0,0 +1,138 @@
+#ifndef _SCHEDULER_
+#define _SCHEDULER_
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+
+// single threaded event loop. Tasks and timers can be posted from any thread, but they all run one after another on
+// the thread that called run(), so the state they touch doesn't need any locking. The thread only wakes up when
+// there is something to do.
+class EventLoop {
+public:
+    using Clock = std::chrono::steady_clock;
+    using Task = std::function<void()>;
+    using TimerId = uint64_t;
+
+    EventLoop() {}
+
+    EventLoop(const EventLoop&) = delete;
+    EventLoop& operator=(const EventLoop&) = delete;
+
+    void post(Task task) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            tasks.push_back(std::move(task));
+        }
+        wakeup.notify_one();
+    }
+
+    TimerId postDelayed(std::chrono::milliseconds delay, Task task) { return addTimer(delay, {}, std::move(task)); }
+
+    // first runs after interval, then every interval measured from when the previous run was due
+    TimerId every(std::chrono::milliseconds interval, Task task) {
+        return addTimer(interval, interval, std::move(task));
+    }
+
+    void cancel(TimerId id) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto timer = timers.find(id);
+        if (timer == timers.end())
+            return;
+
+        auto range = deadlines.equal_range(timer->second.due);
+        for (auto it = range.first; it != range.second; ++it) {
+            if (it->second == id) {
+                deadlines.erase(it);
+                break;
+            }
+        }
+        timers.erase(timer);
+    }
+
+    void run() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (!stopping) {
+            if (!tasks.empty()) {
+                Task task = std::move(tasks.front());
+                tasks.pop_front();
+                lock.unlock();
+                task();
+                lock.lock();
+                continue;
+            }
+
+            if (deadlines.empty()) {
+                wakeup.wait(lock);
+                continue;
+            }
+
+            auto next = deadlines.begin();
+            if (Clock::now() < next->first) {
+                wakeup.wait_until(lock, next->first);
+                continue;
+            }
+
+            Clock::time_point due = next->first;
+            auto timer = timers.find(next->second);
+            deadlines.erase(next);
+
+            Task task = timer->second.task;
+            if (timer->second.interval.count() > 0) {
+                // skip runs that were missed instead of firing them all at once
+                Clock::time_point nextDue = due + timer->second.interval;
+                if (nextDue < Clock::now())
+                    nextDue = Clock::now() + timer->second.interval;
+                timer->second.due = nextDue;
+                deadlines.emplace(nextDue, timer->first);
+            } else
+                timers.erase(timer);
+
+            lock.unlock();
+            task();
+            lock.lock();
+        }
+    }
+
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wakeup.notify_one();
+    }
+
+private:
+    struct Timer {
+        Clock::time_point due;
+        std::chrono::milliseconds interval;
+        Task task;
+    };
+
+    TimerId addTimer(std::chrono::milliseconds delay, std::chrono::milliseconds interval, Task task) {
+        TimerId id;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            id = nextTimerId++;
+            Clock::time_point due = Clock::now() + delay;
+            timers[id] = {due, interval, std::move(task)};
+            deadlines.emplace(due, id);
+        }
+        wakeup.notify_one();
+        return id;
+    }
+
+    std::mutex mutex;
+    std::condition_variable wakeup;
+    std::deque<Task> tasks;
+    std::multimap<Clock::time_point, TimerId> deadlines;
+    std::unordered_map<TimerId, Timer> timers;
+    TimerId nextTimerId = 1;
+    bool stopping = false;
+};
+
+#endif
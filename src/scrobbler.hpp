@@ -0,0 +1,363 @@
+#ifndef _SCROBBLER_
+#define _SCROBBLER_
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "atomicfile.hpp"
+#include "lastfm.hpp"
+#include "metrics.hpp"
+#include "trackkey.hpp"
+
+// scrobbles are written to a journal on disk before anything gets sent, so a network blip, a rate limit or a restart
+// can't lose them. A background thread logs in, submits them in batches and backs off exponentially while last.fm is
+// unreachable or asks us to slow down.
+class ScrobbleQueue {
+public:
+    // a failed request is retried after minBackoff, doubling with every failure up to maxBackoff
+    ScrobbleQueue(std::filesystem::path journal, std::chrono::milliseconds minBackoff = std::chrono::seconds(30),
+                  std::chrono::milliseconds maxBackoff = std::chrono::hours(1))
+        : journal(std::move(journal)), minBackoff(minBackoff), maxBackoff(maxBackoff) {
+        load();
+        worker = std::thread(&ScrobbleQueue::run, this);
+    }
+
+    ~ScrobbleQueue() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wakeup.notify_one();
+        worker.join();
+    }
+
+    ScrobbleQueue(const ScrobbleQueue&) = delete;
+    ScrobbleQueue& operator=(const ScrobbleQueue&) = delete;
+
+    void enqueue(Scrobble scrobble) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (contains(scrobble))
+                return;
+
+            std::ofstream o(journal, std::ios::app);
+            writeEntry(o, scrobble);
+            o.flush();
+            pending.push_back(std::move(scrobble));
+        }
+        wakeup.notify_one();
+    }
+
+    // now playing updates aren't journaled or retried, only the latest one is sent
+    void nowPlaying(Scrobble track) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            nowPlayingTrack = std::move(track);
+            hasNowPlaying = true;
+        }
+        wakeup.notify_one();
+    }
+
+    // the queue only flushes while it has an authenticated client, nullptr pauses it. Scrobbles enqueued meanwhile
+    // stay in the journal until then. A client that isn't logged in yet gets logged in on the worker, as soon as
+    // there is something to send.
+    void setClient(std::shared_ptr<LastFM> lastfm) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            client = std::move(lastfm);
+            backoff = std::chrono::milliseconds(0);
+            retryAt = {};
+            loginBackoff = std::chrono::milliseconds(0);
+            loginRetryAt = {};
+        }
+        wakeup.notify_one();
+    }
+
+    size_t size() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return pending.size();
+    }
+
+private:
+    static std::string sanitize(std::string field) {
+        std::replace_if(
+            field.begin(), field.end(), [](char c) { return c == '\t' || c == '\n' || c == '\r'; }, ' ');
+        return field;
+    }
+
+    // one scrobble per line: timestamp, duration, artist, track and album separated by tabs
+    static void writeEntry(std::ostream& o, const Scrobble& scrobble) {
+        o << scrobble.timestamp << '\t' << scrobble.duration << '\t' << sanitize(scrobble.artist) << '\t'
+          << sanitize(scrobble.track) << '\t' << sanitize(scrobble.album) << '\n';
+    }
+
+    bool contains(const Scrobble& scrobble) const {
+        return std::any_of(pending.begin(), pending.end(), [&scrobble](const Scrobble& other) {
+            return other.timestamp == scrobble.timestamp && other.artist == scrobble.artist &&
+                   other.track == scrobble.track;
+        });
+    }
+
+    void load() {
+        std::ifstream i(journal);
+        std::string line;
+        while (std::getline(i, line)) {
+            std::vector<std::string> fields;
+            size_t start = 0;
+            for (size_t end; (end = line.find('\t', start)) != std::string::npos; start = end + 1)
+                fields.push_back(line.substr(start, end - start));
+            fields.push_back(line.substr(start));
+            if (fields.size() != 5)
+                continue;  // a line that was cut off while writing
+
+            try {
+                Scrobble scrobble{fields[2], fields[3], fields[4], std::stoll(fields[0]), std::stoll(fields[1])};
+                if (!contains(scrobble))
+                    pending.push_back(std::move(scrobble));
+            } catch (...) {
+            }
+        }
+    }
+
+    // rewrites the journal with everything that is still pending
+    void compact() {
+        std::ostringstream o;
+        for (const auto& scrobble : pending) writeEntry(o, scrobble);
+        atomicfile::replace(journal, o.str());
+    }
+
+    static bool isRetryable(LastFM::LASTFM_STATUS status) {
+        switch (status) {
+        case LastFM::NETWORK_ERROR:
+        case LastFM::RATE_LIMIT_REACHED:
+        case LastFM::SERVICE_OFFLINE:
+        case LastFM::SERVICE_TEMPORARILY_UNAVAILABLE:
+        case LastFM::UNKNOWN_ERROR:
+        case LastFM::INVALID_SESSION_KEY:
+        case LastFM::AUTHENTICATION_FAILED:
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    std::chrono::milliseconds nextBackoff(std::chrono::milliseconds backoff) const {
+        return std::min(backoff.count() == 0 ? minBackoff : backoff * 2, maxBackoff);
+    }
+
+    void run() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (!stopping) {
+            auto now = std::chrono::steady_clock::now();
+            bool hasWork = hasNowPlaying || !pending.empty();
+            bool loggedIn = client && client->isAuthenticated();
+            bool loginDue = client && !loggedIn && hasWork && now >= loginRetryAt;
+            bool retryDue = loggedIn && !pending.empty() && now >= retryAt;
+            if (!loginDue && !retryDue && !(loggedIn && hasNowPlaying)) {
+                if (client && !loggedIn && hasWork)
+                    wakeup.wait_until(lock, loginRetryAt);
+                else if (loggedIn && !pending.empty())
+                    wakeup.wait_until(lock, retryAt);
+                else
+                    wakeup.wait(lock);
+                continue;
+            }
+
+            std::shared_ptr<LastFM> lastfm = client;
+            if (loginDue) {
+                lock.unlock();
+                LastFM::LASTFM_STATUS status;
+                {
+                    metrics::ScopedTimer timer(metrics::LASTFM);
+                    status = lastfm->authenticate();
+                    if (status != LastFM::SUCCESS)
+                        timer.fail();
+                }
+                lock.lock();
+                // wrong credentials don't fix themselves either, but new ones from the settings come with a new client
+                if (lastfm == client) {
+                    loginBackoff =
+                        status == LastFM::SUCCESS ? std::chrono::milliseconds(0) : nextBackoff(loginBackoff);
+                    loginRetryAt = std::chrono::steady_clock::now() + loginBackoff;
+                }
+                continue;
+            }
+
+            if (hasNowPlaying) {
+                Scrobble track = std::move(nowPlayingTrack);
+                hasNowPlaying = false;
+                lock.unlock();
+                {
+                    metrics::ScopedTimer timer(metrics::LASTFM);
+                    // best effort, it's stale anyway by the time a retry could happen
+                    if (lastfm->updateNowPlaying(track) != LastFM::SUCCESS)
+                        timer.fail();
+                }
+                lock.lock();
+                continue;
+            }
+
+            size_t count = std::min(pending.size(), LastFM::MAX_SCROBBLE_BATCH);
+            std::vector<Scrobble> batch(pending.begin(), pending.begin() + count);
+
+            lock.unlock();
+            LastFM::LASTFM_STATUS status;
+            {
+                metrics::ScopedTimer timer(metrics::LASTFM);
+                status = lastfm->scrobble(batch);
+                if (status != LastFM::SUCCESS)
+                    timer.fail();
+            }
+            if (status == LastFM::INVALID_SESSION_KEY || status == LastFM::AUTHENTICATION_FAILED)
+                lastfm->authenticate();
+            lock.lock();
+
+            if (status != LastFM::SUCCESS && isRetryable(status)) {
+                backoff = nextBackoff(backoff);
+                retryAt = std::chrono::steady_clock::now() + backoff;
+                continue;
+            }
+
+            // accepted, or rejected for good (e.g. invalid parameters), either way it must not block the queue
+            backoff = std::chrono::milliseconds(0);
+            pending.erase(pending.begin(), pending.begin() + count);
+            compact();
+        }
+    }
+
+    std::filesystem::path journal;
+    std::chrono::milliseconds minBackoff;
+    std::chrono::milliseconds maxBackoff;
+    std::mutex mutex;
+    std::condition_variable wakeup;
+    std::deque<Scrobble> pending;
+    std::shared_ptr<LastFM> client;
+    Scrobble nowPlayingTrack;
+    bool hasNowPlaying = false;
+    std::chrono::milliseconds backoff{0};
+    std::chrono::steady_clock::time_point retryAt;
+    std::chrono::milliseconds loginBackoff{0};
+    std::chrono::steady_clock::time_point loginRetryAt;
+    bool stopping = false;
+    std::thread worker;
+};
+
+// decides when a play counts as a scrobble by last.fm's rules: the track has to be longer than 30 seconds and must
+// have been listened to for half its length or 4 minutes, whichever comes first. Only time actually spent playing
+// counts, pauses and seeks don't. Everything is derived from the snapshots passed to feed(), so a recorded sequence
+// of MediaInfo replays deterministically.
+class ScrobbleTracker {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Events {
+        bool nowPlaying = false;  // a play started or resumed
+        bool scrobble = false;    // the current play just became eligible
+    };
+
+    Events feed(const MediaInfo& media, Clock::time_point now) {
+        Events events;
+        bool playing = !media.paused;
+
+        if (!currentTrack.matches(media)) {
+            currentTrack.assign(media);
+            startPlay(media);
+            events.nowPlaying = playing;
+        } else if (hasSample) {
+            int64_t wallDelta = std::chrono::duration_cast<std::chrono::milliseconds>(now - lastSample).count();
+            int64_t positionDelta = media.songElapsedTime - lastElapsed;
+
+            if (positionDelta < -replayTolerance && media.songElapsedTime < replayTolerance && scrobbled) {
+                // jumped back to the beginning after the play already counted, that's a replay
+                startPlay(media);
+                events.nowPlaying = playing;
+            } else if (lastPlaying) {
+                // moving further than the wall clock did means a seek forward, backwards counts as nothing.
+                // Players that don't report a position at all get the wall clock.
+                if (media.songElapsedTime == 0 && lastElapsed == 0)
+                    listened += wallDelta;
+                else
+                    listened += std::clamp<int64_t>(positionDelta, 0, wallDelta);
+            }
+
+            if (playing && !lastPlaying && !scrobbled)
+                events.nowPlaying = true;
+        } else
+            events.nowPlaying = playing && !scrobbled;
+
+        hasSample = true;
+        lastSample = now;
+        lastElapsed = media.songElapsedTime;
+        lastPlaying = playing;
+
+        if (!scrobbled && isEligible()) {
+            scrobbled = true;
+            events.scrobble = true;
+        }
+        return events;
+    }
+
+    // nothing is playing anymore. The current play is kept in case the same track comes back.
+    void stop() {
+        hasSample = false;
+        lastPlaying = false;
+    }
+
+    // the play feed() reported on, with the time it started
+    const Scrobble& current() const { return track; }
+
+    // listening time still missing until the current play counts, -1 if it already did or never will
+    int64_t remainingMs() const {
+        int64_t required = threshold();
+        if (scrobbled || required < 0)
+            return -1;
+        return std::max<int64_t>(required - listened, 0);
+    }
+
+private:
+    static constexpr int64_t minimumDuration = 30 * 1000;
+    static constexpr int64_t maximumThreshold = 4 * 60 * 1000;
+    static constexpr int64_t replayTolerance = 5 * 1000;
+
+    void startPlay(const MediaInfo& media) {
+        track = {media.songArtist, media.songTitle, media.songAlbum, time(nullptr) - media.songElapsedTime / 1000,
+                 media.songDuration / 1000};
+        listened = 0;
+        scrobbled = false;
+        hasSample = false;
+    }
+
+    int64_t threshold() const {
+        int64_t duration = track.duration * 1000;
+        if (duration > 0 && duration <= minimumDuration)
+            return -1;
+        // without a known length only the 4 minute rule can apply
+        return duration > 0 ? std::min(duration / 2, maximumThreshold) : maximumThreshold;
+    }
+
+    bool isEligible() const {
+        int64_t required = threshold();
+        return required >= 0 && listened >= required;
+    }
+
+    TrackKey currentTrack;
+    Scrobble track{};
+    int64_t listened = 0;
+    bool scrobbled = false;
+    bool hasSample = false;
+    Clock::time_point lastSample;
+    int64_t lastElapsed = 0;
+    bool lastPlaying = false;
+};
+
+#endif
@@ -0,0 +1,205 @@
+#ifndef _SOCKETSOURCE_
+#define _SOCKETSOURCE_
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <nlohmann-json/single_include/nlohmann/json.hpp>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "mediasource.hpp"
+#include "playbackclock.hpp"
+
+// lets other programs tell us what's playing through a unix socket, one json object per line:
+//   {"title": "...", "artist": "...", "album": "...", "source": "...", "art_url": "...", "paused": false,
+//    "duration": 215000, "elapsed": 1200, "rate": 1.0, "artists": ["...", "..."], "url": "...", "track_id": "..."}
+// durations in milliseconds, everything is optional. "artists" is for tracks with more than one, "artist" is the first
+// of them if it's missing. An empty object, {"playing": false} or closing the connection
+// means nothing is playing anymore. The last line from any client wins.
+class SocketSource : public MediaSource {
+public:
+    explicit SocketSource(const std::filesystem::path& path) : path(path) {
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        if (path.native().size() >= sizeof(address.sun_path))
+            return;
+        std::strcpy(address.sun_path, path.c_str());
+
+        listener = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (listener < 0)
+            return;
+        prepare(listener);
+        unlink(path.c_str());  // left behind by an earlier run
+        if (bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 || listen(listener, 4) < 0) {
+            close(listener);
+            listener = -1;
+            return;
+        }
+        chmod(path.c_str(), 0600);  // only our user gets to decide what we show on discord
+    }
+
+    ~SocketSource() {
+        for (const auto& client : clients) close(client.fd);
+        if (listener >= 0) {
+            close(listener);
+            unlink(path.c_str());
+        }
+    }
+
+    SocketSource(const SocketSource&) = delete;
+    SocketSource& operator=(const SocketSource&) = delete;
+
+    bool isListening() const { return listener >= 0; }
+
+    bool waitForMediaChange(std::chrono::milliseconds timeout) override {
+        if (listener < 0) {
+            std::this_thread::sleep_for(timeout);
+            return false;
+        }
+
+        auto deadline = std::chrono::steady_clock::now() + timeout;
+        bool changed = false;
+        while (!changed) {
+            auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline -
+                                                                                  std::chrono::steady_clock::now());
+            if (remaining.count() <= 0)
+                break;
+
+            fds.clear();
+            fds.push_back({listener, POLLIN, 0});
+            for (const auto& client : clients) fds.push_back({client.fd, POLLIN, 0});
+            if (poll(fds.data(), fds.size(), static_cast<int>(remaining.count())) <= 0)
+                continue;
+
+            // clients are only ever appended or removed below, so fds[i + 1] still belongs to clients[i] here
+            for (size_t i = clients.size(); i-- > 0;) {
+                if (fds[i + 1].revents && !readClient(clients[i], changed)) {
+                    if (clients[i].fd == owner) {
+                        owner = -1;
+                        playing = false;
+                        changed = true;
+                    }
+                    close(clients[i].fd);
+                    clients.erase(clients.begin() + i);
+                }
+            }
+            if (fds[0].revents & POLLIN) {
+                int fd;
+                while ((fd = accept(listener, nullptr, nullptr)) >= 0) {
+                    prepare(fd);
+                    clients.push_back({fd, {}});
+                }
+            }
+        }
+        return changed;
+    }
+
+    // the position keeps running between two messages, so a client doesn't have to send one every second
+    bool getMediaInformation(MediaInfo& mediaInfo) override {
+        if (!playing)
+            return false;
+        mediaInfo = media;
+        mediaInfo.songElapsedTime = clock.position();
+        return true;
+    }
+
+private:
+    struct Client {
+        int fd;
+        std::string buffer;
+    };
+
+    static constexpr size_t maxLineLength = 64 * 1024;
+
+    // no SOCK_NONBLOCK and accept4 on macOS
+    static void prepare(int fd) {
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        fcntl(fd, F_SETFD, FD_CLOEXEC);
+    }
+
+    // false once the client is gone or misbehaved
+    bool readClient(Client& client, bool& changed) {
+        char chunk[4096];
+        while (true) {
+            ssize_t length = read(client.fd, chunk, sizeof(chunk));
+            if (length == 0)
+                return false;
+            if (length < 0)
+                return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+            client.buffer.append(chunk, length);
+
+            size_t start = 0;
+            size_t newline;
+            while ((newline = client.buffer.find('\n', start)) != std::string::npos) {
+                if (apply(client.buffer.data() + start, newline - start)) {
+                    owner = client.fd;
+                    changed = true;
+                }
+                start = newline + 1;
+            }
+            client.buffer.erase(0, start);
+            if (client.buffer.size() > maxLineLength)
+                return false;
+        }
+    }
+
+    bool apply(const char* line, size_t length) {
+        nlohmann::json j = nlohmann::json::parse(line, line + length, nullptr, false);
+        if (!j.is_object())
+            return false;  // not json, ignored
+        if (j.empty() || (j.contains("playing") && j["playing"] == false)) {
+            playing = false;
+            return true;
+        }
+
+        media.reset();
+        try {
+            media.songTitle = j.value("title", "");
+            media.songArtists = j.value("artists", std::vector<std::string>());
+            media.songArtist = j.value("artist", media.songArtists.empty() ? "" : media.songArtists.front());
+            if (media.songArtists.empty() && !media.songArtist.empty())
+                media.songArtists.push_back(media.songArtist);
+            media.songAlbum = j.value("album", "");
+            media.songArtUrl = j.value("art_url", "");
+            media.songUrl = j.value("url", "");
+            media.trackId = j.value("track_id", "");
+            media.playbackSource = j.value("source", "");
+            media.paused = j.value("paused", false);
+            media.songDuration = j.value("duration", int64_t(0));
+            media.songElapsedTime = j.value("elapsed", int64_t(0));
+            media.playbackRate = j.value("rate", 1.0);
+            if (media.playbackRate <= 0)
+                media.playbackRate = 1.0;
+        } catch (const nlohmann::json::exception&) {
+            playing = false;  // a field with the wrong type, better show nothing than half of it
+            return true;
+        }
+        clock.start(media.songElapsedTime, media.paused, media.playbackRate, media.songDuration);
+        playing = true;
+        return true;
+    }
+
+    std::filesystem::path path;
+    int listener = -1;
+    std::vector<Client> clients;
+    std::vector<pollfd> fds;
+    int owner = -1;
+    bool playing = false;
+    MediaInfo media;
+    PlaybackClock clock;
+};
+#endif
+
+#endif
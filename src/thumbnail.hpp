@@ -0,0 +1,273 @@
+#ifndef _THUMBNAIL_
+#define _THUMBNAIL_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// a scaled down cover as raw pixels, so the ui can turn it into a bitmap without decoding anything on its thread
+struct Thumbnail {
+    int width = 0;
+    int height = 0;
+    std::vector<unsigned char> rgb;    // width * height * 3
+    std::vector<unsigned char> alpha;  // width * height, empty for opaque images
+};
+
+// turns the cover a player hands us (raw bytes, a file:// url or a data: uri) into a Thumbnail on a worker thread.
+// Results are cached by a hash of the image bytes, players tend to reuse one file for every cover and the same cover
+// shows up for every track of an album. Only the latest request matters, like with the artwork lookup.
+class ThumbnailLoader {
+public:
+    // decodes an encoded image and scales it to fit into maxSize x maxSize, returns null if it can't be decoded. Image
+    // decoding is the ui toolkit's business, so it gets passed in.
+    using Scaler = std::function<std::shared_ptr<const Thumbnail>(const unsigned char* data, size_t size, int maxSize)>;
+    using Callback = std::function<void(std::shared_ptr<const Thumbnail>)>;
+
+    ThumbnailLoader(Scaler scaler, int maxSize = 64, size_t capacity = 32)
+        : scaler(std::move(scaler)), maxSize(maxSize), capacity(capacity), worker(&ThumbnailLoader::run, this) {}
+
+    ~ThumbnailLoader() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wakeup.notify_one();
+        worker.join();
+    }
+
+    ThumbnailLoader(const ThumbnailLoader&) = delete;
+    ThumbnailLoader& operator=(const ThumbnailLoader&) = delete;
+
+    // the bytes win if the backend provided both. onLoaded runs on the worker thread, with null if there is no usable
+    // cover, and is skipped if another request or cancel() came in meanwhile.
+    void request(std::string artUrl, std::string bytes, Callback onLoaded) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            pendingUrl = std::move(artUrl);
+            pendingBytes = std::move(bytes);
+            pendingCallback = std::move(onLoaded);
+            hasPending = true;
+            generation++;
+        }
+        wakeup.notify_one();
+    }
+
+    void cancel() {
+        std::lock_guard<std::mutex> lock(mutex);
+        hasPending = false;
+        pendingCallback = nullptr;
+        generation++;
+    }
+
+private:
+    // read only view of the image bytes, either mapped from a file or owned
+    class ImageData {
+    public:
+        ImageData() {}
+        ~ImageData() {
+#ifndef _WIN32
+            if (mapping)
+                munmap(mapping, mappedSize);
+#endif
+        }
+
+        ImageData(const ImageData&) = delete;
+        ImageData& operator=(const ImageData&) = delete;
+
+        bool map(const std::string& path) {
+#ifndef _WIN32
+            int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+            if (fd < 0)
+                return false;
+            struct stat info;
+            if (fstat(fd, &info) == 0 && info.st_size > 0 && info.st_size <= maxFileSize) {
+                void* address = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (address != MAP_FAILED) {
+                    mapping = address;
+                    mappedSize = info.st_size;
+                }
+            }
+            close(fd);
+            return mapping != nullptr;
+#else
+            std::ifstream file(std::filesystem::u8path(path), std::ios::binary);
+            owned.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+            return !owned.empty() && owned.size() <= maxFileSize;
+#endif
+        }
+
+        std::string owned;
+
+        const unsigned char* data() const {
+            return mapping ? static_cast<const unsigned char*>(mapping)
+                           : reinterpret_cast<const unsigned char*>(owned.data());
+        }
+        size_t size() const { return mapping ? mappedSize : owned.size(); }
+
+    private:
+        void* mapping = nullptr;
+        size_t mappedSize = 0;
+    };
+
+    static constexpr int64_t maxFileSize = 16 * 1024 * 1024;
+
+    static int hexValue(char c) {
+        if (c >= '0' && c <= '9')
+            return c - '0';
+        if (c >= 'a' && c <= 'f')
+            return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F')
+            return c - 'A' + 10;
+        return -1;
+    }
+
+    // file:///home/me/My%20Music/cover.jpg -> /home/me/My Music/cover.jpg
+    static std::string filePath(const std::string& artUrl) {
+        std::string path;
+        size_t start = artUrl.find('/', 7);  // skips an optional host, which is always the local one here
+        for (size_t i = start == std::string::npos ? artUrl.size() : start; i < artUrl.size(); i++) {
+            if (artUrl[i] == '%' && i + 2 < artUrl.size() && hexValue(artUrl[i + 1]) >= 0 &&
+                hexValue(artUrl[i + 2]) >= 0) {
+                path += static_cast<char>(hexValue(artUrl[i + 1]) * 16 + hexValue(artUrl[i + 2]));
+                i += 2;
+            } else
+                path += artUrl[i];
+        }
+        return path;
+    }
+
+    // decodes the base64 payload of a data: uri into the same string, the decoded bytes are never longer
+    static bool decodeDataUri(std::string& uri) {
+        size_t comma = uri.find(',');
+        if (comma == std::string::npos || uri.rfind(";base64", comma) == std::string::npos)
+            return false;
+
+        size_t out = 0;
+        uint32_t buffer = 0;
+        int bits = 0;
+        for (size_t i = comma + 1; i < uri.size(); i++) {
+            char c = uri[i];
+            int value;
+            if (c >= 'A' && c <= 'Z')
+                value = c - 'A';
+            else if (c >= 'a' && c <= 'z')
+                value = c - 'a' + 26;
+            else if (c >= '0' && c <= '9')
+                value = c - '0' + 52;
+            else if (c == '+' || c == '-')
+                value = 62;
+            else if (c == '/' || c == '_')
+                value = 63;
+            else
+                continue;  // padding and line breaks
+            buffer = (buffer << 6) | value;
+            bits += 6;
+            if (bits >= 8) {
+                bits -= 8;
+                uri[out++] = static_cast<char>((buffer >> bits) & 0xff);
+            }
+        }
+        uri.resize(out);
+        return out > 0;
+    }
+
+    static uint64_t hashOf(const unsigned char* data, size_t size) {
+        uint64_t hash = 14695981039346656037ULL;
+        for (size_t i = 0; i < size; i++) hash = (hash ^ data[i]) * 1099511628211ULL;
+        return hash;
+    }
+
+    bool getCached(uint64_t hash, std::shared_ptr<const Thumbnail>& thumbnail) {
+        for (auto it = cache.begin(); it != cache.end(); ++it) {
+            if (it->first == hash) {
+                cache.splice(cache.begin(), cache, it);  // most recently used entries live at the front
+                thumbnail = it->second;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void put(uint64_t hash, std::shared_ptr<const Thumbnail> thumbnail) {
+        cache.emplace_front(hash, std::move(thumbnail));
+        if (cache.size() > capacity)
+            cache.pop_back();
+    }
+
+    std::shared_ptr<const Thumbnail> load(std::string& artUrl, std::string& bytes) {
+        ImageData image;
+        if (!bytes.empty())
+            image.owned = std::move(bytes);
+        else if (artUrl.compare(0, 5, "data:") == 0 && decodeDataUri(artUrl))
+            image.owned = std::move(artUrl);
+        else if (artUrl.compare(0, 7, "file://") != 0 || !image.map(filePath(artUrl)))
+            return nullptr;
+
+        // the cache only lives on this thread, no locking needed
+        uint64_t hash = hashOf(image.data(), image.size());
+        std::shared_ptr<const Thumbnail> thumbnail;
+        if (getCached(hash, thumbnail))
+            return thumbnail;
+        thumbnail = scaler(image.data(), image.size(), maxSize);
+        put(hash, thumbnail);  // images that can't be decoded are cached as well, so they aren't tried again
+        return thumbnail;
+    }
+
+    void run() {
+        while (true) {
+            std::string artUrl;
+            std::string bytes;
+            Callback onLoaded;
+            uint64_t requestGeneration;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wakeup.wait(lock, [this] { return hasPending || stopping; });
+                if (stopping)
+                    return;
+                artUrl = std::move(pendingUrl);
+                bytes = std::move(pendingBytes);
+                onLoaded = std::move(pendingCallback);
+                hasPending = false;
+                requestGeneration = generation;
+            }
+
+            std::shared_ptr<const Thumbnail> thumbnail = load(artUrl, bytes);
+            if (generation == requestGeneration && onLoaded)
+                onLoaded(std::move(thumbnail));
+        }
+    }
+
+    Scaler scaler;
+    int maxSize;
+    size_t capacity;
+    std::list<std::pair<uint64_t, std::shared_ptr<const Thumbnail>>> cache;
+
+    std::mutex mutex;
+    std::condition_variable wakeup;
+    std::string pendingUrl;
+    std::string pendingBytes;
+    Callback pendingCallback;
+    bool hasPending = false;
+    bool stopping = false;
+    std::atomic<uint64_t> generation{0};
+    std::thread worker;
+};
+
+#endif
@@ -0,0 +1,113 @@
+#ifndef _TRACKKEY_
+#define _TRACKKEY_
+
+#include <cctype>
+#include <cstdint>
+#include <string>
+
+#include "backend.hpp"
+
+// identifies a track by title, artist, album and duration. Case and surrounding whitespace are ignored, and the
+// fields are hashed separately so "AB" + "C" and "A" + "BC" don't end up as the same track. Matching a MediaInfo
+// against a key doesn't allocate, so it's cheap enough to do on every poll. Players that give their tracks an id make
+// it exact: two different ids are two different tracks, even when the metadata is the same.
+class TrackKey {
+public:
+    TrackKey() {}
+    explicit TrackKey(const MediaInfo& media) { assign(media); }
+
+    static uint64_t hashOf(const MediaInfo& media) {
+        uint64_t hash = fnvOffset;
+        hash = mix(hash, media.songTitle);
+        hash = mix(hash, media.songArtist);
+        hash = mix(hash, media.songAlbum);
+        uint64_t seconds = static_cast<uint64_t>(media.songDuration / 1000);
+        for (int i = 0; i < 8; i++) hash = (hash ^ ((seconds >> (i * 8)) & 0xff)) * fnvPrime;
+        return hash;
+    }
+
+    // compares the fields directly, hashing the MediaInfo first would only walk every string one more time
+    bool matches(const MediaInfo& media) const {
+        if (differentIds(trackId, media.trackId))
+            return false;
+        return valid && duration == media.songDuration / 1000 && equals(title, media.songTitle) &&
+               equals(artist, media.songArtist) && equals(album, media.songAlbum);
+    }
+
+    // only allocates if the new fields don't fit into the strings of the previous track
+    void assign(const MediaInfo& media) {
+        hash = hashOf(media);
+        title.assign(media.songTitle);
+        artist.assign(media.songArtist);
+        album.assign(media.songAlbum);
+        trackId.assign(media.trackId);
+        duration = media.songDuration / 1000;
+        valid = true;
+    }
+
+    void reset() { valid = false; }
+    bool empty() const { return !valid; }
+    uint64_t value() const { return hash; }
+
+    bool operator==(const TrackKey& other) const {
+        if (!valid || !other.valid)
+            return valid == other.valid;
+        if (differentIds(trackId, other.trackId))
+            return false;
+        return hash == other.hash && duration == other.duration && equals(title, other.title) &&
+               equals(artist, other.artist) && equals(album, other.album);
+    }
+    bool operator!=(const TrackKey& other) const { return !(*this == other); }
+
+private:
+    static constexpr uint64_t fnvOffset = 14695981039346656037ULL;
+    static constexpr uint64_t fnvPrime = 1099511628211ULL;
+
+    // ascii only on purpose, std::tolower goes through the locale for every byte and leaves utf-8 alone anyway
+    static uint8_t lower(char c) {
+        uint8_t byte = static_cast<uint8_t>(c);
+        return byte >= 'A' && byte <= 'Z' ? byte + ('a' - 'A') : byte;
+    }
+
+    static void trim(const std::string& field, size_t& begin, size_t& end) {
+        begin = 0;
+        end = field.size();
+        while (begin < end && std::isspace(static_cast<unsigned char>(field[begin]))) begin++;
+        while (end > begin && std::isspace(static_cast<unsigned char>(field[end - 1]))) end--;
+    }
+
+    static uint64_t mix(uint64_t hash, const std::string& field) {
+        size_t begin, end;
+        trim(field, begin, end);
+        for (size_t i = begin; i < end; i++)
+            hash = (hash ^ lower(field[i])) * fnvPrime;
+        return (hash ^ 0xff) * fnvPrime;  // field separator, 0xff never shows up in utf-8 text
+    }
+
+    static bool differentIds(const std::string& a, const std::string& b) {
+        return !a.empty() && !b.empty() && a != b;
+    }
+
+    static bool equals(const std::string& a, const std::string& b) {
+        size_t aBegin, aEnd, bBegin, bEnd;
+        trim(a, aBegin, aEnd);
+        trim(b, bBegin, bEnd);
+        if (aEnd - aBegin != bEnd - bBegin)
+            return false;
+        for (size_t i = 0; i < aEnd - aBegin; i++) {
+            if (lower(a[aBegin + i]) != lower(b[bBegin + i]))
+                return false;
+        }
+        return true;
+    }
+
+    uint64_t hash = 0;
+    std::string title;
+    std::string artist;
+    std::string album;
+    std::string trackId;
+    int64_t duration = 0;
+    bool valid = false;
+};
+
+#endif
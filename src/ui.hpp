@@ -0,0 +1,99 @@
+#ifndef _UI_
+#define _UI_
+#include <wx/clipbrd.h>
+#include <wx/mstream.h>
+#include <wx/wx.h>
+
+#include <cstring>
+#include <memory>
+#include <string>
+
+#include "thumbnail.hpp"
+
+// wxwidgets helpers, only the tray application includes this so the daemon doesn't have to link wx at all
+namespace ui {
+    inline void copyToClipboard(const wxString& text) {
+        if (wxTheClipboard->Open()) {
+            wxTheClipboard->Clear();
+            wxTheClipboard->SetData(new wxTextDataObject(text));
+            wxTheClipboard->Close();
+        }
+    }
+
+    inline wxBitmap loadImageFromMemory(const unsigned char* data, size_t size, int width = 0, int height = 0) {
+        wxMemoryInputStream stream(data, size);
+        wxImage img(stream, wxBITMAP_TYPE_PNG);
+        if (img.IsOk()) {
+            if (width != 0 || height != 0)
+                img.Rescale(width, height, wxIMAGE_QUALITY_HIGH);
+            wxBitmap bmp(img);
+            return bmp;
+        }
+        return wxNullBitmap;
+    }
+
+    // used as the pipeline's thumbnail scaler, so it runs on the loader's thread. wxImage doesn't touch the gui, unlike
+    // wxBitmap, that one gets created from the result in the tray menu.
+    inline std::shared_ptr<const Thumbnail> scaleThumbnail(const unsigned char* data, size_t size, int maxSize) {
+        wxMemoryInputStream stream(data, size);
+        wxLogNull noLog;  // a broken cover isn't worth an error dialog
+        wxImage img(stream, wxBITMAP_TYPE_ANY);
+        if (!img.IsOk())
+            return nullptr;
+        double scale = std::min(1.0, static_cast<double>(maxSize) / std::max(img.GetWidth(), img.GetHeight()));
+        int width = std::max(1, static_cast<int>(img.GetWidth() * scale + 0.5));
+        int height = std::max(1, static_cast<int>(img.GetHeight() * scale + 0.5));
+        if (width != img.GetWidth() || height != img.GetHeight())
+            img.Rescale(width, height, wxIMAGE_QUALITY_HIGH);
+
+        auto thumbnail = std::make_shared<Thumbnail>();
+        thumbnail->width = width;
+        thumbnail->height = height;
+        thumbnail->rgb.assign(img.GetData(), img.GetData() + width * height * 3);
+        if (img.HasAlpha())
+            thumbnail->alpha.assign(img.GetAlpha(), img.GetAlpha() + width * height);
+        return thumbnail;
+    }
+
+    inline wxBitmap thumbnailBitmap(const Thumbnail& thumbnail) {
+        wxImage img(thumbnail.width, thumbnail.height, false);
+        std::memcpy(img.GetData(), thumbnail.rgb.data(), thumbnail.rgb.size());
+        if (!thumbnail.alpha.empty()) {
+            img.SetAlpha();
+            std::memcpy(img.GetAlpha(), thumbnail.alpha.data(), thumbnail.alpha.size());
+        }
+        return wxBitmap(img);
+    }
+
+    inline wxIcon loadIconFromMemory(const unsigned char* data, size_t size, int width = 0, int height = 0) {
+        wxIcon icn{};
+        icn.CopyFromBitmap(loadImageFromMemory(data, size, width, height));
+        return icn;
+    }
+
+    inline wxBitmap loadColoredSVG(const unsigned char* svg, const unsigned int svg_size, const wxSize& size,
+                                   const wxColour& color) {
+        const std::string defaultColor = "currentColor";
+        std::string svg_data = std::string((const char*)svg, svg_size);
+        size_t start_pos = svg_data.find(defaultColor);
+        if (start_pos != std::string::npos)
+            svg_data.replace(start_pos, defaultColor.length(), color.GetAsString(wxC2S_HTML_SYNTAX));
+
+        wxBitmapBundle bundle = wxBitmapBundle::FromSVG(svg_data.c_str(), size);
+        if (!bundle.IsOk())
+            return wxNullBitmap;
+        wxBitmap bmp = bundle.GetBitmap(size);
+        if (!bmp.IsOk())
+            return wxNullBitmap;
+        return bmp;
+    }
+
+    inline wxBitmap loadSettingsIcon(const unsigned char* svg, const unsigned int svg_size,
+                                     const wxSize& size = wxSize(16, 16)) {
+        return loadColoredSVG(
+            svg, svg_size, size,
+            wxSystemSettings::GetAppearance().IsSystemDark() ? wxColor(255, 255, 255, 255) : wxColor(0, 0, 0, 255));
+    }
+}  // namespace ui
+
+#endif
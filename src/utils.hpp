@@ -1,17 +1,22 @@
 #ifndef _UTILS_
 #define _UTILS_
-#include <curl/include/curl/curl.h>
-#include <wx/mstream.h>
-#include <wx/wx.h>
-#include <wx/clipbrd.h>
+#include <algorithm>
+#include <cctype>
 #include <filesystem>
 #include <fstream>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <nlohmann-json/single_include/nlohmann/json.hpp>
 #include <sstream>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
+#include "atomicfile.hpp"
 #include "backend.hpp"
+#include "http.hpp"
 
 #define DEFAULT_CLIENT_ID "1301849203378622545"
 #define DEFAULT_APP_NAME "Music"
@@ -39,12 +44,41 @@ namespace utils {
         std::string api_secret;
     };
 
+    // see metrics.hpp, PLAYERLINK_METRICS=1 (or =trace) turns them on without touching the settings
+    struct MetricsSettings {
+        bool enabled = false;
+        bool trace = false;
+    };
+
+    struct CaseInsensitiveHash {
+        size_t operator()(const std::string& str) const {
+            // fnv-1a over the lowercase characters, so lookups don't need a lowercase copy of the key
+            uint64_t hash = 14695981039346656037ull;
+            for (unsigned char c : str) {
+                hash ^= static_cast<uint64_t>(std::tolower(c));
+                hash *= 1099511628211ull;
+            }
+            return static_cast<size_t>(hash);
+        }
+    };
+
+    struct CaseInsensitiveEqual {
+        bool operator()(const std::string& a, const std::string& b) const {
+            return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(), [](unsigned char x, unsigned char y) {
+                       return std::tolower(x) == std::tolower(y);
+                   });
+        }
+    };
+
     struct Settings {
         bool odesli;
         bool autoStart;
         bool anyOtherEnabled;
         LastFMSettings lastfm;
+        MetricsSettings metrics;
         std::vector<App> apps;
+        // process name -> index into apps, rebuilt whenever the settings change
+        std::unordered_map<std::string, size_t, CaseInsensitiveHash, CaseInsensitiveEqual> appIndex;
     };
 
     struct SongInfo {
@@ -52,56 +86,6 @@ namespace utils {
         int64_t trackId;
     };
 
-    inline void copyToClipboard(const wxString& text) {
-        if (wxTheClipboard->Open()) {
-            wxTheClipboard->Clear();
-            wxTheClipboard->SetData(new wxTextDataObject(text));
-            wxTheClipboard->Close();
-        }
-    }
-
-    inline wxBitmap loadImageFromMemory(const unsigned char* data, size_t size, int width = 0, int height = 0) {
-        wxMemoryInputStream stream(data, size);
-        wxImage img(stream, wxBITMAP_TYPE_PNG);
-        if (img.IsOk()) {
-            if (width != 0 || height != 0)
-                img.Rescale(width, height, wxIMAGE_QUALITY_HIGH);
-            wxBitmap bmp(img);
-            return bmp;
-        }
-        return wxNullBitmap;
-    }
-
-    inline wxIcon loadIconFromMemory(const unsigned char* data, size_t size, int width = 0, int height = 0) {
-        wxIcon icn{};
-        icn.CopyFromBitmap(loadImageFromMemory(data, size, width, height));
-        return icn;
-    }
-
-    inline wxBitmap loadColoredSVG(const unsigned char* svg, const unsigned int svg_size, const wxSize& size,
-                                   const wxColour& color) {
-        const std::string defaultColor = "currentColor";
-        std::string svg_data = std::string((const char*)svg, svg_size);
-        size_t start_pos = svg_data.find(defaultColor);
-        if (start_pos != std::string::npos)
-            svg_data.replace(start_pos, defaultColor.length(), color.GetAsString(wxC2S_HTML_SYNTAX));
-
-        wxBitmapBundle bundle = wxBitmapBundle::FromSVG(svg_data.c_str(), size);
-        if (!bundle.IsOk())
-            return wxNullBitmap;
-        wxBitmap bmp = bundle.GetBitmap(size);
-        if (!bmp.IsOk())
-            return wxNullBitmap;
-        return bmp;
-    }
-
-    inline wxBitmap loadSettingsIcon(const unsigned char* svg, const unsigned int svg_size,
-                                     const wxSize& size = wxSize(16, 16)) {
-        return loadColoredSVG(
-            svg, svg_size, size,
-            wxSystemSettings::GetAppearance().IsSystemDark() ? wxColor(255, 255, 255, 255) : wxColor(0, 0, 0, 255));
-    }
-
     inline std::string toLower(const std::string& str) {
         std::string lowerStr = str;
         std::transform(lowerStr.begin(), lowerStr.end(), lowerStr.begin(),
@@ -109,7 +93,7 @@ namespace utils {
         return lowerStr;
     }
 
-    inline bool caseInsensitiveMatch(const std::string& a, const std::string& b) { return toLower(a) == toLower(b); }
+    inline bool caseInsensitiveMatch(const std::string& a, const std::string& b) { return CaseInsensitiveEqual()(a, b); }
 
     inline std::string ltrim(std::string& s) {
         s.erase(s.begin(), std::find_if(s.begin(), s.end(), [](unsigned char ch) { return !std::isspace(ch); }));
@@ -142,11 +126,6 @@ namespace utils {
         return encoded.str();
     }
 
-    inline size_t curlWriteCallback(char* contents, size_t size, size_t nmemb, void* userp) {
-        ((std::string*)userp)->append((char*)contents, size * nmemb);
-        return size * nmemb;
-    }
-
     inline std::string getURLEncodedPostBody(const std::map<std::string, std::string>& parameters) {
         if (parameters.empty())
             return "";
@@ -162,31 +141,18 @@ namespace utils {
     }
 
     inline std::string httpRequest(std::string url, std::string requestType = "GET", std::string postData = "") {
-        CURL* curl;
-        CURLcode res;
-        std::string buf;
-        curl_global_init(CURL_GLOBAL_ALL);
-        curl = curl_easy_init();
-        if (curl) {
-            curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
-            curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, requestType.c_str());
-            if (requestType != "GET" && requestType != "DELETE" && postData.length() > 0)
-                curl_easy_setopt(curl, CURLOPT_POSTFIELDS, postData.c_str());
-
-            curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, curlWriteCallback);
-            curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0L);
-            curl_easy_setopt(curl, CURLOPT_WRITEDATA, &buf);
-            res = curl_easy_perform(curl);
-            curl_easy_cleanup(curl);
-        }
-        curl_global_cleanup();
-        return buf;
+        return HttpClient::get().request(url, requestType, postData);
     }
 
-    inline SongInfo getSongInfo(std::string query) {
+    // succeeded tells apart "itunes doesn't know this song" from a failed or aborted request
+    inline SongInfo getSongInfo(std::string query, const std::function<bool()>& shouldAbort = nullptr,
+                                bool* succeeded = nullptr) {
         SongInfo ret{};
-        std::string response =
-            httpRequest("https://itunes.apple.com/search?media=music&entity=song&term=" + urlEncode(query));
+        if (succeeded)
+            *succeeded = false;
+        std::string response = HttpClient::get().request(
+            "https://itunes.apple.com/search?media=music&entity=song&term=" + urlEncode(query), "GET", "", nullptr,
+            shouldAbort);
         try {
             nlohmann::json j = nlohmann::json::parse(response);
             auto results = j["results"];
@@ -194,66 +160,19 @@ namespace utils {
                 ret.artworkURL = results[0]["artworkUrl100"].get<std::string>();
                 ret.trackId = results[0]["trackId"].get<int64_t>();
             }
+            if (succeeded)
+                *succeeded = true;
             return ret;
         } catch (...) {
             return ret;
         }
     }
 
-    inline std::string getOdesliURL(SongInfo& song) {
+    inline std::string getOdesliURL(const SongInfo& song) {
         return std::string("https://song.link/i/" + std::to_string(song.trackId));
     }
 
-    inline void saveSettings(const App* newApp) {
-        nlohmann::json j;
-
-        if (std::filesystem::exists(CONFIG_FILENAME)) {
-            std::ifstream i(CONFIG_FILENAME);
-            i >> j;
-        }
-
-        if (!j.contains("apps")) {
-            j["apps"] = nlohmann::json::array();
-        }
-
-        bool appFound = false;
-
-        for (auto& appJson : j["apps"]) {
-            if (appJson["name"] == newApp->appName) {
-                appJson["client_id"] = newApp->clientId;
-                appJson["search_endpoint"] = newApp->searchEndpoint;
-                appJson["enabled"] = newApp->enabled;
-
-                appJson["process_names"].clear();
-                for (const auto& processName : newApp->processNames) {
-                    appJson["process_names"].push_back(processName);
-                }
-
-                appFound = true;
-                break;
-            }
-        }
-
-        if (!appFound) {
-            nlohmann::json appJson;
-            appJson["name"] = newApp->appName;
-            appJson["client_id"] = newApp->clientId;
-            appJson["search_endpoint"] = newApp->searchEndpoint;
-            appJson["enabled"] = newApp->enabled;
-
-            for (const auto& processName : newApp->processNames) {
-                appJson["process_names"].push_back(processName);
-            }
-
-            j["apps"].push_back(appJson);
-        }
-
-        std::ofstream o(CONFIG_FILENAME);
-        o << j.dump(4);
-        o.close();
-    }
-
-    inline void saveSettings(const Settings& settings) {
+    inline std::string serializeSettings(const Settings& settings) {
         nlohmann::json j;
         j["autostart"] = settings.autoStart;
         j["any_other"] = settings.anyOtherEnabled;
@@ -265,6 +184,9 @@ namespace utils {
         j["lastfm"]["username"] = settings.lastfm.username;
         j["lastfm"]["password"] = settings.lastfm.password;
 
+        j["metrics"]["enabled"] = settings.metrics.enabled;
+        j["metrics"]["trace"] = settings.metrics.trace;
+
         for (const auto& app : settings.apps) {
             nlohmann::json appJson;
             appJson["name"] = app.appName;
@@ -278,25 +200,25 @@ namespace utils {
             j["apps"].push_back(appJson);
         }
 
-        std::ofstream o(CONFIG_FILENAME);
-        o << j.dump(4);
-        o.close();
+        return j.dump(4);
     }
-    inline Settings getSettings() {
-        std::filesystem::create_directories(backend::getConfigDirectory());
-        Settings ret;
-        if (!std::filesystem::exists(CONFIG_FILENAME)) {
-            ret.anyOtherEnabled = true;
-            ret.autoStart = false;
-            ret.odesli = false;
-            saveSettings(ret);
-            return ret;
-        }
 
+    // edits come in bursts, e.g. one per keystroke in the last.fm fields, so they only reach the disk once things
+    // calmed down. The previous file is kept as settings.json.bak.
+    inline DebouncedWriter& settingsWriter() {
+        static DebouncedWriter writer(CONFIG_FILENAME);
+        return writer;
+    }
+
+    inline void saveSettings(const Settings& settings) { settingsWriter().schedule(serializeSettings(settings)); }
+
+    // blocks until saved settings are on the disk, for when the process is about to go away without running the
+    // static destructors
+    inline void flushSettings() { settingsWriter().flush(); }
+
+    inline bool parseSettings(const std::string& contents, Settings& ret) {
         try {
-            std::ifstream i(CONFIG_FILENAME);
-            nlohmann::json j;
-            i >> j;
+            nlohmann::json j = nlohmann::json::parse(contents);
 
             ret.autoStart = j.value("autostart", false);
             ret.anyOtherEnabled = j.value("any_other", false);
@@ -311,6 +233,11 @@ namespace utils {
                 ret.lastfm.password = lastfm.value("password", "");
             }
 
+            if (j.contains("metrics")) {
+                ret.metrics.enabled = j["metrics"].value("enabled", false);
+                ret.metrics.trace = j["metrics"].value("trace", false);
+            }
+
             for (const auto& app : j["apps"]) {
                 App a;
                 a.appName = app.value("name", "");
@@ -324,27 +251,147 @@ namespace utils {
 
                 ret.apps.push_back(a);
             }
-        } catch (const nlohmann::json::parse_error&) {
+        } catch (const nlohmann::json::exception&) {
+            return false;
         }
-        return ret;
+        return true;
     }
 
-    inline App getApp(std::string processName) {
-        auto settings = getSettings();
-        for (auto app : settings.apps) {
-            for (auto procName : app.processNames) {
-                if (caseInsensitiveMatch(procName, processName))
-                    return app;
-            }
+    inline Settings loadSettings() {
+        std::filesystem::create_directories(backend::getConfigDirectory());
+        Settings ret;
+        std::string contents;
+        if (!std::filesystem::exists(CONFIG_FILENAME)) {
+            ret.anyOtherEnabled = true;
+            ret.autoStart = false;
+            ret.odesli = false;
+            saveSettings(ret);
+            return ret;
+        }
+        if (atomicfile::read(CONFIG_FILENAME, contents) && parseSettings(contents, ret))
+            return ret;
+
+        // a broken settings.json must not replace the last good backup
+        settingsWriter().setBackup(false);
+        std::filesystem::path backupFile = CONFIG_FILENAME;
+        backupFile += ".bak";
+        Settings backup;
+        if (atomicfile::read(backupFile, contents) && parseSettings(contents, backup)) {
+            saveSettings(backup);  // puts the good version back in place
+            return backup;
         }
-        App a;
-        a.clientId = DEFAULT_CLIENT_ID;
-        a.appName = DEFAULT_APP_NAME;
-        a.enabled = settings.anyOtherEnabled;
-        a.type = 2;  // Default to listening
-        a.displayType = 0;
-        a.searchEndpoint = "";
-        return a;
+        return Settings{};
+    }
+
+    inline void buildAppIndex(Settings& settings) {
+        settings.appIndex.clear();
+        for (size_t i = 0; i < settings.apps.size(); i++) {
+            // emplace keeps the first app if a process name is listed twice, same as the old linear search
+            for (const auto& processName : settings.apps[i].processNames) settings.appIndex.emplace(processName, i);
+        }
+    }
+
+    inline std::shared_ptr<const Settings>& currentSettings() {
+        static std::shared_ptr<const Settings> settings;
+        return settings;
+    }
+
+    inline std::function<void()>& settingsListener() {
+        static std::function<void()> listener;
+        return listener;
+    }
+
+    // gets called from whichever thread published new settings, has to be set before anything reads the settings
+    inline void onSettingsChanged(std::function<void()> listener) { settingsListener() = std::move(listener); }
+
+    inline void publishSettings(Settings settings) {
+        buildAppIndex(settings);
+        std::atomic_store(&currentSettings(), std::make_shared<const Settings>(std::move(settings)));
+        if (settingsListener())
+            settingsListener()();
+    }
+
+    inline std::mutex& settingsMutex() {
+        static std::mutex mutex;
+        return mutex;
+    }
+
+    // called by the file watcher. Our own writes show up there as well and edits that aren't on the disk yet are newer
+    // than the file, neither of them is worth parsing the file again.
+    inline void reloadSettings() {
+        std::string contents;
+        atomicfile::read(CONFIG_FILENAME, contents);
+        std::lock_guard<std::mutex> lock(settingsMutex());
+        if (settingsWriter().isOwnWrite(contents))
+            return;
+        publishSettings(loadSettings());
+    }
+
+    // settings.json is parsed once and then only again when the file changes on disk. Readers get an immutable
+    // snapshot, so they never have to care about someone saving the settings at the same time.
+    inline std::shared_ptr<const Settings> getSettings() {
+        static std::once_flag loaded;
+        std::call_once(loaded, [] {
+            publishSettings(loadSettings());
+            backend::watchConfigFile(CONFIG_FILENAME, reloadSettings);
+        });
+        return std::atomic_load(&currentSettings());
+    }
+
+    // applies a change to a copy of the current settings, publishes it to all readers right away and saves it soon
+    template <typename F>
+    inline void updateSettings(F&& update) {
+        std::lock_guard<std::mutex> lock(settingsMutex());
+        Settings settings = *getSettings();
+        update(settings);
+        saveSettings(settings);
+        publishSettings(std::move(settings));
+    }
+
+    inline void saveSettings(const App* newApp) {
+        updateSettings([newApp](Settings& settings) {
+            for (auto& app : settings.apps) {
+                if (app.appName == newApp->appName) {
+                    app.clientId = newApp->clientId;
+                    app.searchEndpoint = newApp->searchEndpoint;
+                    app.enabled = newApp->enabled;
+                    app.processNames = newApp->processNames;
+                    return;
+                }
+            }
+            settings.apps.push_back(*newApp);
+        });
+    }
+
+    inline std::vector<std::string> getProcessNames(const Settings& settings) {
+        std::vector<std::string> processNames;
+        for (const auto& app : settings.apps)
+            processNames.insert(processNames.end(), app.processNames.begin(), app.processNames.end());
+        return processNames;
+    }
+
+    inline const App* findApp(const Settings& settings, const std::string& processName) {
+        auto it = settings.appIndex.find(processName);
+        return it == settings.appIndex.end() ? nullptr : &settings.apps[it->second];
+    }
+
+    // same answer as getApp(settings, processName).enabled
+    inline bool isAppEnabled(const Settings& settings, const std::string& processName) {
+        const App* app = findApp(settings, processName);
+        return app ? app->enabled : settings.anyOtherEnabled;
+    }
+
+    // the configured app, or the generic one for anything not in the list. Points into settings or a static, valid as
+    // long as the settings are, nothing gets copied.
+    inline const App& getApp(const Settings& settings, const std::string& processName) {
+        if (const App* app = findApp(settings, processName))
+            return *app;
+
+        static const App anyOther[2] = {
+            {false, 2, 0, DEFAULT_APP_NAME, DEFAULT_CLIENT_ID, "", {}},  // Default to listening
+            {true, 2, 0, DEFAULT_APP_NAME, DEFAULT_CLIENT_ID, "", {}},
+        };
+        return anyOther[settings.anyOtherEnabled ? 1 : 0];
     }
 }  // namespace utils
 